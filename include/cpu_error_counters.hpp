@@ -0,0 +1,284 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <dbus_objects.hpp>
+#include <latency_histogram.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <settings_cache.hpp>
+#include <timer_wheel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace host_error_monitor::cpu_error_counters
+{
+static constexpr bool debug = false;
+
+// Per-CPU error counts kept in memory as the source of truth. Each count is
+// read from Settings once, incremented here, and written back at most once
+// per flush interval, so errors on several CPUs, or repeated errors on one,
+// never race each other through a read-modify-write on D-Bus.
+class CPUErrorCounters
+{
+    using LatencyHistogram =
+        host_error_monitor::latency_histogram::LatencyHistogram;
+    using TimerWheel = host_error_monitor::timer_wheel::TimerWheel;
+
+    struct Counter
+    {
+        // Unset until the count has been read from Settings
+        std::optional<uint8_t> value;
+        // Increments made before the count was read
+        size_t pending = 0;
+        bool loading = false;
+        // Set when the count has changed since it was last written
+        bool dirty = false;
+        size_t writesInFlight = 0;
+    };
+
+    static const constexpr char* prefix = "ErrorCountCPU";
+    static const constexpr size_t flushIntervalMsDefault = 1000;
+
+    host_error_monitor::settings_cache::SettingsObject& settings;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> statisticsInterface;
+
+    std::map<size_t, Counter> counters;
+    size_t flushIntervalMs = flushIntervalMsDefault;
+    TimerWheel::Timer flushTimer;
+
+    uint64_t flushes = 0;
+    uint64_t flushFailures = 0;
+    LatencyHistogram flushLatency;
+
+    static std::string propertyName(size_t cpu)
+    {
+        return prefix + std::to_string(cpu + 1);
+    }
+
+    void load(size_t cpu)
+    {
+        Counter& counter = counters[cpu];
+        if (counter.loading)
+        {
+            return;
+        }
+        counter.loading = true;
+        std::string name = propertyName(cpu);
+        settings.get<uint8_t>(name, [this, cpu,
+                                     name](std::optional<uint8_t> value) {
+            Counter& counter = counters[cpu];
+            counter.loading = false;
+            if (!value)
+            {
+                // The increments are kept and the read is tried again on the
+                // next error
+                std::cerr << "Failed to read " << name << "\n";
+                return;
+            }
+            counter.value = *value;
+            apply(cpu, counter);
+        });
+    }
+
+    void apply(size_t cpu, Counter& counter)
+    {
+        if (counter.pending == 0)
+        {
+            return;
+        }
+        constexpr size_t max = std::numeric_limits<uint8_t>::max();
+        size_t count = std::min(*counter.value + counter.pending, max);
+        counter.pending = 0;
+        if (count == *counter.value)
+        {
+            std::cerr << "Maximum error count reached\n";
+            return;
+        }
+        if constexpr (debug)
+        {
+            std::cerr << propertyName(cpu) << " is now " << count << "\n";
+        }
+        counter.value = static_cast<uint8_t>(count);
+        counter.dirty = true;
+        scheduleFlush();
+    }
+
+    void scheduleFlush()
+    {
+        if (!flushTimer.pending())
+        {
+            flushTimer.schedule(TimerWheel::Clock::now() +
+                                    std::chrono::milliseconds(flushIntervalMs),
+                                [this]() { flush(); });
+        }
+    }
+
+    // Write each changed count with one Set
+    void flush()
+    {
+        for (auto& [cpu, counter] : counters)
+        {
+            if (!counter.dirty)
+            {
+                continue;
+            }
+            counter.dirty = false;
+            counter.writesInFlight++;
+            TimerWheel::Clock::time_point start = TimerWheel::Clock::now();
+            settings.set(
+                propertyName(cpu), *counter.value,
+                [this, cpu = cpu, start](boost::system::error_code ec) {
+                    Counter& counter = counters[cpu];
+                    counter.writesInFlight--;
+                    if (ec)
+                    {
+                        // Write the latest count again on the next flush
+                        flushFailures++;
+                        counter.dirty = true;
+                        scheduleFlush();
+                        return;
+                    }
+                    flushes++;
+                    flushLatency.record(TimerWheel::Clock::now() - start);
+                });
+        }
+    }
+
+    // A count changed in Settings by someone else, for example cleared by
+    // an administrator, replaces the one here unless it has a newer change
+    void external(const std::string& name,
+                  const host_error_monitor::settings_cache::SettingValue& value)
+    {
+        if (name.rfind(prefix, 0) != 0)
+        {
+            return;
+        }
+        const uint8_t* count = std::get_if<uint8_t>(&value);
+        size_t cpuNum = 0;
+        try
+        {
+            cpuNum = std::stoul(name.substr(std::string(prefix).size()));
+        }
+        catch (std::exception& e)
+        {
+            return;
+        }
+        auto counter = counters.find(cpuNum - 1);
+        if (count == nullptr || cpuNum == 0 || counter == counters.end() ||
+            !counter->second.value || counter->second.dirty ||
+            counter->second.writesInFlight > 0)
+        {
+            return;
+        }
+        counter->second.value = *count;
+    }
+
+  public:
+    CPUErrorCounters(boost::asio::io_context& io,
+                     std::shared_ptr<sdbusplus::asio::connection> conn) :
+        settings(
+            host_error_monitor::settings_cache::getProcessorErrorConfig(conn)),
+        flushTimer(host_error_monitor::timer_wheel::getTimerWheel(io))
+    {
+        settings.addChangeHandler(
+            [this](const std::string& name,
+                   const host_error_monitor::settings_cache::SettingValue&
+                       value) { external(name, value); });
+
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        statisticsInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/ErrorCounters",
+            "xyz.openbmc_project.HostErrorMonitor.ErrorCounters");
+        statisticsInterface->register_property(
+            "FlushIntervalMs", flushIntervalMs,
+            [this](const size_t& requested, size_t& resp) {
+                flushIntervalMs = requested;
+                resp = requested;
+                return 1;
+            });
+        statisticsInterface->register_property(
+            "LatencyBucketBoundsUs", LatencyHistogram::getBucketBoundsUs());
+        statisticsInterface->register_property_r(
+            "FlushLatencyCounts", std::vector<uint64_t>{},
+            sdbusplus::vtable::property_::none,
+            [this](const std::vector<uint64_t>&) {
+                return flushLatency.getCounts();
+            });
+        statisticsInterface->register_property_r(
+            "FlushLatencyMaxUs", uint64_t(0),
+            sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return flushLatency.getMaxUs(); });
+        statisticsInterface->register_property_r(
+            "Flushes", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return flushes; });
+        statisticsInterface->register_property_r(
+            "FlushFailures", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return flushFailures; });
+        publisher.initialize(statisticsInterface);
+    }
+
+    CPUErrorCounters(const CPUErrorCounters&) = delete;
+    CPUErrorCounters& operator=(const CPUErrorCounters&) = delete;
+
+    /** @brief Count an error on a CPU. The count saturates at 255.
+     *  @param[in] cpu - Zero-based CPU number
+     */
+    void increment(size_t cpu)
+    {
+        Counter& counter = counters[cpu];
+        counter.pending++;
+        if (!counter.value)
+        {
+            return load(cpu);
+        }
+        apply(cpu, counter);
+    }
+
+    /** @brief Get the count of a CPU
+     *  @param[in] cpu - Zero-based CPU number
+     *  @return The count, or unset if it has not been read from Settings
+     */
+    std::optional<uint8_t> get(size_t cpu) const
+    {
+        auto counter = counters.find(cpu);
+        if (counter == counters.end())
+        {
+            return std::nullopt;
+        }
+        return counter->second.value;
+    }
+};
+
+inline CPUErrorCounters&
+    getCPUErrorCounters(boost::asio::io_context& io,
+                        std::shared_ptr<sdbusplus::asio::connection> conn)
+{
+    static CPUErrorCounters counters(io, conn);
+    return counters;
+}
+
+} // namespace host_error_monitor::cpu_error_counters
@@ -0,0 +1,405 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <peci_access.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+namespace host_error_monitor::cpu_registers
+{
+using host_error_monitor::peci_access::Model;
+using host_error_monitor::peci_access::Status;
+
+static inline bool peciError(Status peciStatus, uint8_t cc)
+{
+    return (peciStatus != Status::success ||
+            (cc != host_error_monitor::peci_access::ccSuccess &&
+             cc != host_error_monitor::peci_access::ccFatalMCADetected));
+}
+
+static inline void printPECIError(const std::string& reg, const size_t addr,
+                                  const Status peciStatus, const size_t cc)
+{
+    // Format separately so the PECI worker thread never changes the
+    // std::cerr flags under the io_context thread
+    std::ostringstream msg;
+    msg << "Failed to read " << reg << " on CPU address " << std::dec << addr
+        << ". Error: " << static_cast<int>(peciStatus) << ": cc: 0x"
+        << std::hex << cc << "\n";
+    std::cerr << msg.str();
+}
+
+// How a register is accessed over PECI
+enum class Space
+{
+    pkgConfig,
+    iaMSR,
+    pciConfigLocal,
+    endPointPciLocal,
+};
+
+// What a register is used for by the triage
+enum class Role
+{
+    none,
+    errPinSts,
+    mcaErrSrcLog,
+    mc4Status,
+    coreFIVRErrLog,
+    uncoreFIVRErrLog,
+};
+
+struct Register
+{
+    Role role;
+    const char* name;
+    Space space;
+    uint8_t segment;
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+    // PCI register offset, package config index or MSR address
+    uint16_t offset;
+    // Package config parameter
+    uint16_t param;
+};
+
+static constexpr size_t maxRegisters = 6;
+
+struct ModelRegisters
+{
+    Model model;
+    // Unused entries have Role::none
+    std::array<Register, maxRegisters> registers;
+};
+
+// Registers of each supported CPU model. A new model only needs an entry
+// here.
+static constexpr std::array<ModelRegisters, 2> modelRegisters = {{
+    {Model::skylake,
+     {{
+         // B(0) D8 F0 offset 210h
+         {Role::errPinSts, "ERRPINSTS", Space::pciConfigLocal, 0, 0, 8, 0,
+          0x210, 0},
+         {Role::mcaErrSrcLog, "MCA_ERR_SRC_LOG", Space::pkgConfig, 0, 0, 0,
+          0, 0, 5},
+         {Role::mc4Status, "IA32_MC4_STATUS", Space::iaMSR, 0, 0, 0, 0, 0x411,
+          0},
+         // B(1) D30 F2 offset 80h
+         {Role::coreFIVRErrLog, "CORE_FIVR_ERR_LOG", Space::pciConfigLocal, 0,
+          1, 30, 2, 0x80, 0},
+         // B(1) D30 F2 offset 84h
+         {Role::uncoreFIVRErrLog, "UNCORE_FIVR_ERR_LOG", Space::pciConfigLocal,
+          0, 1, 30, 2, 0x84, 0},
+         {Role::none, "", Space::pkgConfig, 0, 0, 0, 0, 0, 0},
+     }}},
+    {Model::iceLake,
+     {{
+         // B(30) D0 F3 offset 274h (Bus 30 is accessed on PECI as bus 13)
+         {Role::errPinSts, "ERRPINSTS", Space::endPointPciLocal, 0, 13, 0, 3,
+          0x274, 0},
+         {Role::mcaErrSrcLog, "MCA_ERR_SRC_LOG", Space::pkgConfig, 0, 0, 0,
+          0, 0, 5},
+         {Role::mc4Status, "IA32_MC4_STATUS", Space::iaMSR, 0, 0, 0, 0, 0x411,
+          0},
+         // B(31) D30 F2 offsets C0h and C4h (Bus 31 is accessed on PECI as
+         // bus 14)
+         {Role::coreFIVRErrLog, "CORE_FIVR_ERR_LOG_0",
+          Space::endPointPciLocal, 0, 14, 30, 2, 0xC0, 0},
+         {Role::coreFIVRErrLog, "CORE_FIVR_ERR_LOG_1",
+          Space::endPointPciLocal, 0, 14, 30, 2, 0xC4, 0},
+         // B(31) D30 F2 offset 84h
+         {Role::uncoreFIVRErrLog, "UNCORE_FIVR_ERR_LOG",
+          Space::endPointPciLocal, 0, 14, 30, 2, 0x84, 0},
+     }}},
+}};
+
+constexpr const ModelRegisters* findModel(Model model)
+{
+    for (const ModelRegisters& entry : modelRegisters)
+    {
+        if (entry.model == model)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// MSMI_INTERNAL (20) and IERR_INTERNAL (27) in MCA_ERR_SRC_LOG mark the CPU
+// that caused the IERR
+static constexpr uint64_t ierrSourceMask = (1 << 20) | (1 << 27);
+
+// An IERR cause is identified either by the MSEC bits 31:24 of
+// IA32_MC4_STATUS or by any register with the given role being non-zero.
+// Causes are checked in order and the first match wins.
+struct IERRCause
+{
+    const char* type;
+    Role nonZero;
+    std::array<uint8_t, 3> msec;
+    size_t numMsec;
+};
+
+static constexpr std::array<IERRCause, 4> ierrCauses = {{
+    // MCA_SVID_VCCIN_VR_ICC_MAX_FAILURE (0x40),
+    // MCA_SVID_VCCIN_VR_VOUT_FAILURE (0x42) or
+    // MCA_SVID_CPU_VR_CAPABILITY_ERROR (0x43)
+    {"CPU/VR Mismatch", Role::none, {0x40, 0x42, 0x43}, 3},
+    {"Core FIVR Fault", Role::coreFIVRErrLog, {}, 0},
+    {"Uncore FIVR Fault", Role::uncoreFIVRErrLog, {}, 0},
+    // Both FIVR logs are zero, but MCA_FIVR_CATAS_OVERVOL_FAULT (0x51) or
+    // MCA_FIVR_CATAS_OVERCUR_FAULT (0x52) is set
+    {"Uncore FIVR Fault", Role::none, {0x51, 0x52}, 2},
+}};
+
+static inline std::optional<uint64_t> readRegister(uint8_t addr,
+                                                   const Register& reg)
+{
+    Status peciStatus = Status::success;
+    uint8_t cc = 0;
+    uint64_t value = 0;
+    uint32_t value32 = 0;
+    host_error_monitor::peci_access::PECIAccess& peci =
+        host_error_monitor::peci_access::getPECIAccess();
+    switch (reg.space)
+    {
+        case Space::pkgConfig:
+            peciStatus = peci.rdPkgConfig(addr, reg.offset, reg.param,
+                                         sizeof(value32),
+                                         (uint8_t*)&value32, &cc);
+            value = value32;
+            break;
+        case Space::iaMSR:
+            peciStatus = peci.rdIAMSR(addr, 0, reg.offset, &value, &cc);
+            break;
+        case Space::pciConfigLocal:
+            peciStatus = peci.rdPCIConfigLocal(
+                addr, reg.bus, reg.device, reg.function, reg.offset,
+                sizeof(value32), (uint8_t*)&value32, &cc);
+            value = value32;
+            break;
+        case Space::endPointPciLocal:
+            peciStatus = peci.rdEndPointConfigPciLocal(
+                addr, reg.segment, reg.bus, reg.device, reg.function,
+                reg.offset, sizeof(value32), (uint8_t*)&value32, &cc);
+            value = value32;
+            break;
+    }
+    if (peciError(peciStatus, cc))
+    {
+        printPECIError(reg.name, addr, peciStatus, cc);
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Register values read for one CPU, indexed like ModelRegisters::registers
+using RegisterValues = std::array<std::optional<uint64_t>, maxRegisters>;
+
+/** @brief Read every register with a role that has not been read yet,
+ *         stopping at the first failure
+ *  @return False if a read failed
+ */
+static inline bool readRole(uint8_t addr, const ModelRegisters& model,
+                            Role role, RegisterValues& values)
+{
+    for (size_t i = 0; i < model.registers.size(); i++)
+    {
+        if (model.registers[i].role != role || values[i])
+        {
+            continue;
+        }
+        values[i] = readRegister(addr, model.registers[i]);
+        if (!values[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline std::optional<size_t> findRole(const ModelRegisters& model,
+                                             Role role)
+{
+    for (size_t i = 0; i < model.registers.size(); i++)
+    {
+        if (model.registers[i].role == role)
+        {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+/** @brief Check if a cause matches the register values
+ *  @return The match, or nullopt if a register it needs was not read
+ */
+static inline std::optional<bool> causeMatches(const ModelRegisters& model,
+                                               const IERRCause& cause,
+                                               const RegisterValues& values)
+{
+    if (cause.numMsec > 0)
+    {
+        std::optional<size_t> mc4Status = findRole(model, Role::mc4Status);
+        if (!mc4Status || !values[*mc4Status])
+        {
+            return std::nullopt;
+        }
+        uint64_t msec = (*values[*mc4Status] >> 24) & 0xFF;
+        for (size_t i = 0; i < cause.numMsec; i++)
+        {
+            if (msec == cause.msec[i])
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool nonZero = false;
+    for (size_t i = 0; i < model.registers.size(); i++)
+    {
+        if (model.registers[i].role != cause.nonZero)
+        {
+            continue;
+        }
+        if (!values[i])
+        {
+            return std::nullopt;
+        }
+        nonZero |= *values[i] != 0;
+    }
+    return nonZero;
+}
+
+/** @brief Decode the IERR registers of a CPU
+ *  @param[in] addr - PECI address of the CPU
+ *  @param[in] model - CPU model
+ *  @return Unset if the CPU did not cause the IERR. Otherwise the cause,
+ *          which is empty if no specific cause was found and unset if the
+ *          registers could not be read.
+ */
+static inline std::optional<std::optional<std::string>>
+    decodeIERR(uint8_t addr, Model model)
+{
+    const ModelRegisters* registers = findModel(model);
+    if (registers == nullptr)
+    {
+        std::cerr << "No special IERR handling provided for model "
+                  << static_cast<int>(model) << "\n";
+        return std::nullopt;
+    }
+
+    RegisterValues values;
+    if (!readRole(addr, *registers, Role::mcaErrSrcLog, values))
+    {
+        return std::nullopt;
+    }
+    std::optional<size_t> mcaErrSrcLog =
+        findRole(*registers, Role::mcaErrSrcLog);
+    if (!mcaErrSrcLog || !(*values[*mcaErrSrcLog] & ierrSourceMask))
+    {
+        return std::nullopt;
+    }
+
+    for (const IERRCause& cause : ierrCauses)
+    {
+        // Only read what this cause needs, so the triage ends with the PECI
+        // reads of the first match
+        Role role = cause.numMsec > 0 ? Role::mc4Status : cause.nonZero;
+        std::optional<bool> match;
+        if (readRole(addr, *registers, role, values))
+        {
+            match = causeMatches(*registers, cause, values);
+        }
+        if (!match)
+        {
+            // The registers needed to go further could not be read
+            return std::optional<std::string>();
+        }
+        if (*match)
+        {
+            return std::optional<std::string>(cause.type);
+        }
+    }
+    return std::optional<std::string>("");
+}
+
+// Registers captured when an error pin first asserts and again when it times
+// out, to give a first look at the CPU state ahead of the crashdump
+static constexpr std::array<Role, 3> snapshotRoles = {
+    Role::mcaErrSrcLog, Role::mc4Status, Role::errPinSts};
+static constexpr std::array<const char*, snapshotRoles.size()> snapshotNames =
+    {"MCA_ERR_SRC_LOG", "IA32_MC4_STATUS", "ERRPINSTS"};
+
+// Snapshot register values, indexed like snapshotRoles. Unset if the
+// register could not be read.
+using SnapshotValues =
+    std::array<std::optional<uint64_t>, snapshotRoles.size()>;
+
+/** @brief Read the snapshot registers of a CPU
+ *  @param[in] addr - PECI address of the CPU
+ *  @param[in] model - CPU model
+ *  @return The register values
+ */
+static inline SnapshotValues readSnapshot(uint8_t addr, Model model)
+{
+    SnapshotValues values;
+    const ModelRegisters* registers = findModel(model);
+    if (registers == nullptr)
+    {
+        return values;
+    }
+    for (size_t i = 0; i < snapshotRoles.size(); i++)
+    {
+        std::optional<size_t> reg = findRole(*registers, snapshotRoles[i]);
+        if (reg)
+        {
+            values[i] = readRegister(addr, registers->registers[*reg]);
+        }
+    }
+    return values;
+}
+
+/** @brief Check if a CPU asserted an ERRx pin
+ *  @param[in] addr - PECI address of the CPU
+ *  @param[in] model - CPU model
+ *  @param[in] errPin - ERRx pin number
+ *  @return True if ERRPINSTS shows the CPU asserted the pin
+ */
+static inline bool decodeErrPinSts(uint8_t addr, Model model, size_t errPin)
+{
+    const ModelRegisters* registers = findModel(model);
+    if (registers == nullptr)
+    {
+        return false;
+    }
+    RegisterValues values;
+    std::optional<size_t> errPinSts = findRole(*registers, Role::errPinSts);
+    if (!errPinSts || !readRole(addr, *registers, Role::errPinSts, values))
+    {
+        return false;
+    }
+    return (*values[*errPinSts] & (1 << errPin)) != 0;
+}
+
+} // namespace host_error_monitor::cpu_registers
@@ -0,0 +1,139 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace host_error_monitor::dbus_objects
+{
+static const constexpr char* serviceName =
+    "xyz.openbmc_project.HostErrorMonitor";
+
+// Approximates the process start time, as it is set before main() runs
+inline const std::chrono::steady_clock::time_point processStart =
+    std::chrono::steady_clock::now();
+
+// The one object server of the daemon. Interfaces added while the monitors
+// start are held back until they have all started. They are then registered
+// before the daemon takes its service name, and announced with a single
+// InterfacesAdded signal per object once it has. The ObjectMapper and
+// clients only follow signals sent from the service name, so the signal
+// sdbusplus sends as each interface is registered goes unheard. Interfaces
+// added after that are published at once.
+class ObjectPublisher
+{
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    sdbusplus::asio::object_server server;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> startupInterface;
+
+    std::vector<std::shared_ptr<sdbusplus::asio::dbus_interface>> held;
+    bool published = false;
+    uint64_t publishTimeUs = 0;
+    uint64_t publishedAtStartup = 0;
+
+  public:
+    explicit ObjectPublisher(
+        std::shared_ptr<sdbusplus::asio::connection> conn) :
+        conn(conn), server(conn)
+    {
+        // Lets a client get every object with one GetManagedObjects call
+        server.add_manager("/xyz/openbmc_project/host_error_monitor");
+
+        startupInterface = server.add_interface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/Startup",
+            "xyz.openbmc_project.HostErrorMonitor.Startup");
+        startupInterface->register_property_r(
+            "PublishTimeUs", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return publishTimeUs; });
+        startupInterface->register_property_r(
+            "PublishedInterfaces", uint64_t(0),
+            sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return publishedAtStartup; });
+        initialize(startupInterface);
+    }
+
+    ObjectPublisher(const ObjectPublisher&) = delete;
+    ObjectPublisher& operator=(const ObjectPublisher&) = delete;
+
+    std::shared_ptr<sdbusplus::asio::dbus_interface>
+        addInterface(const std::string& path, const std::string& name)
+    {
+        return server.add_interface(path, name);
+    }
+
+    /** @brief Publish an interface once its properties and methods are
+     *         registered. It is held back until publish() during startup.
+     *  @param[in] iface - Interface to publish
+     */
+    void initialize(std::shared_ptr<sdbusplus::asio::dbus_interface> iface)
+    {
+        if (published)
+        {
+            iface->initialize();
+            return;
+        }
+        held.push_back(std::move(iface));
+    }
+
+    /** @brief Publish every interface held back during startup and take the
+     *         service name
+     */
+    void publish()
+    {
+        if (published)
+        {
+            return;
+        }
+        published = true;
+        std::map<std::string, std::vector<std::string>> objects;
+        for (const std::shared_ptr<sdbusplus::asio::dbus_interface>& iface :
+             held)
+        {
+            // InterfacesAdded already carries the initial property values
+            iface->initialize(true);
+            objects[iface->get_object_path()].push_back(
+                iface->get_interface_name());
+        }
+        conn->request_name(serviceName);
+        for (const auto& [path, interfaces] : objects)
+        {
+            conn->emit_interfaces_added(path.c_str(), interfaces);
+        }
+        publishedAtStartup = held.size();
+        held.clear();
+        publishTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - processStart)
+                            .count();
+        std::cerr << "Published " << publishedAtStartup << " interfaces "
+                  << publishTimeUs << "us after start\n";
+    }
+};
+
+inline ObjectPublisher&
+    getObjectPublisher(std::shared_ptr<sdbusplus::asio::connection> conn)
+{
+    static ObjectPublisher publisher(conn);
+    return publisher;
+}
+
+} // namespace host_error_monitor::dbus_objects
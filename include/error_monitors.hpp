@@ -14,10 +14,21 @@
 // limitations under the License.
 */
 #pragma once
+#include <cpu_error_counters.hpp>
+#include <dbus_objects.hpp>
+#include <gpio_line.hpp>
+#include <log_queue.hpp>
+#include <peci_worker.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <settings_cache.hpp>
 // #include <error_monitors/smi_monitor.hpp>
 
+#include <chrono>
+#include <iostream>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace host_error_monitor::error_monitors
 {
@@ -25,6 +36,49 @@ namespace host_error_monitor::error_monitors
 // static std::unique_ptr<host_error_monitor::smi_monitor::SMIMonitor>
 // smiMonitor;
 
+// Construction time of each startup step, reported once all monitors start
+static std::vector<std::pair<std::string, std::chrono::microseconds>>
+    startupTimes;
+
+template <typename Step>
+static void timeStartupStep(const std::string& name, Step&& step)
+{
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    step();
+    startupTimes.emplace_back(
+        name, std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start));
+}
+
+// Construct a signal monitor and record how long its construction took
+template <typename Monitor, typename... Args>
+static std::unique_ptr<Monitor>
+    makeMonitor(boost::asio::io_context& io,
+                std::shared_ptr<sdbusplus::asio::connection> conn,
+                const std::string& signalName, Args&&... args)
+{
+    std::unique_ptr<Monitor> monitor;
+    timeStartupStep(signalName, [&]() {
+        monitor = std::make_unique<Monitor>(io, conn, signalName,
+                                            std::forward<Args>(args)...);
+    });
+    return monitor;
+}
+
+static void logStartupTimes()
+{
+    std::chrono::microseconds total(0);
+    std::cerr << "Monitor startup times:\n";
+    for (const auto& [name, time] : startupTimes)
+    {
+        std::cerr << "  " << name << ": " << time.count() << "us\n";
+        total += time;
+    }
+    std::cerr << "  Total: " << total.count() << "us\n";
+    startupTimes.clear();
+}
+
 // Check if all the signal monitors started successfully
 bool checkMonitors()
 {
@@ -40,10 +94,36 @@ bool startMonitors(
     [[maybe_unused]] boost::asio::io_context& io,
     [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn)
 {
-    // smiMonitor =
-    // std::make_unique<host_error_monitor::smi_monitor::SMIMonitor>(
+    // Index the GPIO line names once so each monitor finds its line without
+    // scanning every gpiochip
+    timeStartupStep("GPIO line index",
+                    []() { host_error_monitor::gpio_line::getLineIndex(); });
+
+    // Load the recovery settings before any error needs them
+    host_error_monitor::settings_cache::getProcessorErrorConfig(conn);
+    host_error_monitor::settings_cache::getResetDisables(conn);
+    host_error_monitor::cpu_error_counters::getCPUErrorCounters(io, conn);
+
+#ifdef SEND_TO_LOGGING_SERVICE
+    // Create the log queue now, rather than on the first log, so its
+    // statistics object is published with the others
+    host_error_monitor::log_queue::getLogQueue(io, conn);
+#endif
+
+#ifdef LIBPECI
+    host_error_monitor::peci_worker::getPECIWorker(io).registerStatistics(
+        conn);
+#endif
+
+    // smiMonitor = makeMonitor<host_error_monitor::smi_monitor::SMIMonitor>(
     //     io, conn, "SMI");
 
+    logStartupTimes();
+
+    // Publish the objects of every monitor together now that they have all
+    // started
+    host_error_monitor::dbus_objects::getObjectPublisher(conn).publish();
+
     return checkMonitors();
 }
 
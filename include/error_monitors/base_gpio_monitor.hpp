@@ -14,13 +14,18 @@
 // limitations under the License.
 */
 #pragma once
-#include <boost/asio/posix/stream_descriptor.hpp>
+#include <dbus_objects.hpp>
 #include <error_monitors/base_monitor.hpp>
-#include <gpiod.hpp>
+#include <gpio_event_hub.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <timer_wheel.hpp>
 
+#include <array>
+#include <chrono>
 #include <iostream>
+#include <optional>
+#include <string>
 
 namespace host_error_monitor::base_gpio_monitor
 {
@@ -32,48 +37,58 @@ enum class AssertValue
     highAssert = 1,
 };
 
+// Kernel debounce period for the thermal and VR alert lines, which glitch
+// on transitions. Edges shorter than this are filtered before they wake the
+// monitor.
+static constexpr std::chrono::microseconds noisyLineDebounce =
+    std::chrono::microseconds(1000);
+
+enum class ChatterMode
+{
+    normal,
+    summarizing,
+};
+
 class BaseGPIOMonitor : public host_error_monitor::base_monitor::BaseMonitor
 {
-    gpiod::line line;
-    boost::asio::posix::stream_descriptor event;
+    host_error_monitor::gpio_line::GPIOLine line;
 
     AssertValue assertValue;
+    bool monitoring = false;
+    bool lastAsserted = false;
+    // State last passed to the assert and deassert handlers. It lags
+    // lastAsserted while an edge storm is summarized.
+    bool handledAsserted = false;
 
-    virtual void logEvent() {}
-
-    bool requestEvents()
-    {
-        line = gpiod::find_line(signalName);
-        if (!line)
-        {
-            std::cerr << "Failed to find the " << signalName << " line\n";
-            return false;
-        }
+    std::array<host_error_monitor::gpio_line::LineEvent,
+               host_error_monitor::gpio_line::GPIOLine::eventBufferSize>
+        eventBuffer;
 
-        try
-        {
-            line.request(
-                {"host-error-monitor", gpiod::line_request::EVENT_BOTH_EDGES,
-                 assertValue == AssertValue::highAssert
-                     ? 0
-                     : gpiod::line_request::FLAG_ACTIVE_LOW});
-        }
-        catch (std::exception&)
-        {
-            std::cerr << "Failed to request events for " << signalName << "\n";
-            return false;
-        }
+    // Chatter suppression: a line with more than stormEdgeThreshold edges in
+    // one window is summarized once per window until it drops to
+    // calmEdgeThreshold edges or fewer
+    bool chatterSuppression = false;
+    ChatterMode chatterMode = ChatterMode::normal;
+    uint32_t stormEdgeThreshold = 20;
+    uint32_t calmEdgeThreshold = 4;
+    uint32_t windowMs = 1000;
+    host_error_monitor::timer_wheel::TimerWheel::Timer windowTimer;
+    size_t windowEdges = 0;
+    size_t windowAssertEdges = 0;
+    // Time the line spent asserted during the window, measured on the clock
+    // of the edge timestamps
+    std::chrono::nanoseconds windowAssertedTime{0};
+    std::optional<std::chrono::nanoseconds> assertedSince;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> chatterInterface;
 
-        int lineFd = line.event_get_fd();
-        if (lineFd < 0)
-        {
-            std::cerr << "Failed to get " << signalName << " fd\n";
-            return false;
-        }
-
-        event.assign(lineFd);
+    virtual void logEvent() {}
 
-        return true;
+    bool requestEvents(std::chrono::microseconds debounce)
+    {
+        line = host_error_monitor::gpio_event_hub::getHub(io).requestEvents(
+            signalName, assertValue == AssertValue::lowAssert, debounce,
+            [this]() { handleEvent(); });
+        return static_cast<bool>(line);
     }
 
     bool asserted()
@@ -83,11 +98,26 @@ class BaseGPIOMonitor : public host_error_monitor::base_monitor::BaseMonitor
             std::cerr << "Checking " << signalName << " state\n";
         }
 
-        return (line.get_value());
+        std::error_code ec;
+        bool value = line.getValue(ec);
+        if (ec)
+        {
+            std::cerr << "Failed to read " << signalName
+                      << " value: " << ec.message() << "\n";
+        }
+        return value;
     }
 
-    void checkEvent(bool assertEvent)
+    /** @brief Handle a change of the line state
+     *  @param[in] assertEvent - True if the line asserted
+     *  @param[in] edge - Kernel timestamp of the assert edge, if known
+     */
+    void checkEvent(bool assertEvent,
+                    std::optional<std::chrono::nanoseconds> edge = std::nullopt)
     {
+        lastAsserted = assertEvent;
+        handledAsserted = assertEvent;
+        setSummaryAsserted(assertEvent);
         if (assertEvent)
         {
             if constexpr (debug)
@@ -95,6 +125,11 @@ class BaseGPIOMonitor : public host_error_monitor::base_monitor::BaseMonitor
                 std::cerr << signalName << " asserted\n";
             }
 
+            if (edge)
+            {
+                recordEdge(*edge);
+            }
+            recordAssertHandlerEntry();
             assertHandler();
         }
         else
@@ -104,6 +139,7 @@ class BaseGPIOMonitor : public host_error_monitor::base_monitor::BaseMonitor
                 std::cerr << signalName << " deasserted\n";
             }
 
+            clearEdge();
             deassertHandler();
         }
     }
@@ -118,40 +154,244 @@ class BaseGPIOMonitor : public host_error_monitor::base_monitor::BaseMonitor
     virtual void deassertHandler() {}
 
   private:
-    void waitForEvent()
+    void handleEvent()
     {
         if constexpr (debug)
         {
-            std::cerr << "Wait for " << signalName << "\n";
+            std::cerr << signalName << " event ready\n";
         }
 
-        event.async_wait(
-            boost::asio::posix::stream_descriptor::wait_read,
-            [this](const boost::system::error_code ec) {
-                if (ec)
+        // Drain every queued edge in one pass
+        size_t assertEdges = 0;
+        size_t deassertEdges = 0;
+        bool finalAsserted = lastAsserted;
+        std::optional<std::chrono::nanoseconds> assertTimestamp;
+        std::error_code ec;
+        size_t count = 0;
+        do
+        {
+            count = line.readEvents(eventBuffer, ec);
+            for (size_t i = 0; i < count; i++)
+            {
+                trackResidency(eventBuffer[i]);
+                finalAsserted = eventBuffer[i].asserted;
+                if (finalAsserted)
                 {
-                    // operation_aborted is expected if wait is canceled.
-                    if (ec != boost::asio::error::operation_aborted)
+                    if (!assertTimestamp)
                     {
-                        std::cerr << signalName
-                                  << " wait error: " << ec.message() << "\n";
+                        assertTimestamp = eventBuffer[i].timestamp;
                     }
-                    return;
+                    assertEdges++;
                 }
+                else
+                {
+                    deassertEdges++;
+                }
+            }
+        } while (count == eventBuffer.size());
+        if (ec)
+        {
+            std::cerr << signalName << " event read failed: " << ec.message()
+                      << "\n";
+        }
+
+        if constexpr (debug)
+        {
+            std::cerr << signalName << " read " << assertEdges
+                      << " assert and " << deassertEdges
+                      << " deassert edges\n";
+        }
+
+        if (!monitoring || (assertEdges == 0 && deassertEdges == 0))
+        {
+            return;
+        }
+
+        if (chatterSuppression)
+        {
+            countWindowEdges(assertEdges, deassertEdges);
+            if (chatterMode == ChatterMode::summarizing)
+            {
+                // The edges are reported in the window summary instead, but
+                // the summary keeps following the line
+                lastAsserted = finalAsserted;
+                setSummaryAsserted(finalAsserted);
+                return;
+            }
+        }
 
-                if constexpr (debug)
+        // Redundant assert/deassert pairs collapse into the final state. If
+        // the line bounced back to where it started, report one
+        // representative transition so a short pulse is never lost.
+        if (finalAsserted == lastAsserted &&
+            (lastAsserted ? deassertEdges : assertEdges) > 0)
+        {
+            checkEvent(!finalAsserted, assertTimestamp);
+        }
+        if (finalAsserted != lastAsserted)
+        {
+            checkEvent(finalAsserted, assertTimestamp);
+        }
+    }
+
+    static std::string toString(ChatterMode mode)
+    {
+        return mode == ChatterMode::summarizing ? "Summarizing" : "Normal";
+    }
+
+    void trackResidency(const host_error_monitor::gpio_line::LineEvent& event)
+    {
+        if (!chatterSuppression)
+        {
+            return;
+        }
+        if (event.asserted)
+        {
+            if (!assertedSince)
+            {
+                assertedSince = event.timestamp;
+            }
+        }
+        else if (assertedSince)
+        {
+            windowAssertedTime += event.timestamp - *assertedSince;
+            assertedSince.reset();
+        }
+    }
+
+    void countWindowEdges(size_t assertEdges, size_t deassertEdges)
+    {
+        windowEdges += assertEdges + deassertEdges;
+        windowAssertEdges += assertEdges;
+        if (!windowTimer.pending())
+        {
+            startWindow();
+        }
+
+        if (chatterMode == ChatterMode::normal &&
+            windowEdges > stormEdgeThreshold)
+        {
+            setChatterMode(ChatterMode::summarizing);
+            std::cerr << signalName << " edge storm detected, summarizing\n";
+        }
+    }
+
+    void setChatterMode(ChatterMode mode)
+    {
+        chatterMode = mode;
+        chatterInterface->set_property("Mode", toString(mode));
+    }
+
+    void startWindow()
+    {
+        windowTimer.schedule(
+            host_error_monitor::timer_wheel::TimerWheel::Clock::now() +
+                std::chrono::milliseconds(windowMs),
+            [this]() { endWindow(); });
+    }
+
+    void endWindow()
+    {
+        std::chrono::nanoseconds now =
+            host_error_monitor::gpio_line::eventClockNow();
+        if (assertedSince)
+        {
+            windowAssertedTime += now - *assertedSince;
+            assertedSince = now;
+        }
+
+        if (chatterMode == ChatterMode::summarizing)
+        {
+            logStormSummary();
+            if (windowEdges <= calmEdgeThreshold)
+            {
+                setChatterMode(ChatterMode::normal);
+                std::cerr << signalName << " edge storm ended\n";
+                // Report the state the line settled in
+                bool settled = asserted();
+                if (settled != handledAsserted)
                 {
-                    std::cerr << signalName << " event ready\n";
+                    checkEvent(settled);
                 }
+                else
+                {
+                    lastAsserted = settled;
+                    setSummaryAsserted(settled);
+                }
+            }
+        }
+
+        bool busy = chatterMode == ChatterMode::summarizing || windowEdges > 0;
+        windowEdges = 0;
+        windowAssertEdges = 0;
+        windowAssertedTime = std::chrono::nanoseconds(0);
+        if (busy)
+        {
+            startWindow();
+        }
+    }
 
-                gpiod::line_event gpioLineEvent = line.event_read();
+    void logStormSummary()
+    {
+        std::chrono::milliseconds assertedMs =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                windowAssertedTime);
+        std::string msg = signalName + " edge storm: " +
+                          std::to_string(windowAssertEdges) +
+                          " assertions, asserted " +
+                          std::to_string(assertedMs.count()) + " of " +
+                          std::to_string(windowMs) + " ms";
+        // Summaries are not Redfish events
+        log_message(LOG_WARNING, msg, "", "");
+    }
 
-                // With FLAG_ACTIVE_LOW enabled, both active-high and active-low
-                // signals have a RISING_EDGE event when asserted
-                checkEvent(gpioLineEvent.event_type ==
-                           gpiod::line_event::RISING_EDGE);
-                waitForEvent();
+    void registerChatterProperties()
+    {
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        chatterInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/" + signalName,
+            "xyz.openbmc_project.HostErrorMonitor.ChatterSuppression");
+        chatterInterface->register_property(
+            "StormEdgeThreshold", stormEdgeThreshold,
+            [this](const uint32_t& req, uint32_t& resp) {
+                if (req == 0)
+                {
+                    return false;
+                }
+                stormEdgeThreshold = req;
+                resp = req;
+                return true;
             });
+        chatterInterface->register_property(
+            "CalmEdgeThreshold", calmEdgeThreshold,
+            [this](const uint32_t& req, uint32_t& resp) {
+                calmEdgeThreshold = req;
+                resp = req;
+                return true;
+            });
+        chatterInterface->register_property(
+            "WindowMs", windowMs, [this](const uint32_t& req, uint32_t& resp) {
+                if (req == 0)
+                {
+                    return false;
+                }
+                windowMs = req;
+                resp = req;
+                return true;
+            });
+        chatterInterface->register_property("Mode", toString(chatterMode));
+        publisher.initialize(chatterInterface);
+    }
+
+  protected:
+    /** @brief Summarize edge storms on this line instead of handling every
+     *         edge. Only for monitors whose handlers just log.
+     */
+    void enableChatterSuppression()
+    {
+        chatterSuppression = true;
+        registerChatterProperties();
     }
 
   public:
@@ -162,16 +402,33 @@ class BaseGPIOMonitor : public host_error_monitor::base_monitor::BaseMonitor
             std::cerr << "Monitoring " << signalName << "\n";
         }
 
-        checkEvent(asserted());
-        waitForEvent();
+        monitoring = true;
+        clearEdge();
+        bool assertedNow = asserted();
+        if (chatterSuppression && assertedNow)
+        {
+            assertedSince = host_error_monitor::gpio_line::eventClockNow();
+        }
+        checkEvent(assertedNow);
     }
 
-    BaseGPIOMonitor(boost::asio::io_context& io,
-                    std::shared_ptr<sdbusplus::asio::connection> conn,
-                    const std::string& signalName, AssertValue assertValue) :
-        BaseMonitor(io, conn, signalName), event(io), assertValue(assertValue)
+    /** @brief Constructor to create a GPIO edge signal monitor
+     *  @param[in] io - ASIO io_context
+     *  @param[in] conn - ASIO connection
+     *  @param[in] signalName - GPIO name of the signal to monitor
+     *  @param[in] assertValue - GPIO value that indicates assertion
+     *  @param[in] debounce - Kernel debounce period for noisy lines. Only
+     *                        supported by the libgpiod v2 backend.
+     */
+    BaseGPIOMonitor(
+        boost::asio::io_context& io,
+        std::shared_ptr<sdbusplus::asio::connection> conn,
+        const std::string& signalName, AssertValue assertValue,
+        std::chrono::microseconds debounce = std::chrono::microseconds(0)) :
+        BaseMonitor(io, conn, signalName), assertValue(assertValue),
+        windowTimer(host_error_monitor::timer_wheel::getTimerWheel(io))
     {
-        if (!requestEvents())
+        if (!requestEvents(debounce))
         {
             return;
         }
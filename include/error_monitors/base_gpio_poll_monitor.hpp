@@ -14,14 +14,20 @@
 // limitations under the License.
 */
 #pragma once
-#include <boost/asio/posix/stream_descriptor.hpp>
-#include <boost/asio/steady_timer.hpp>
+#include <dbus_objects.hpp>
 #include <error_monitors/base_monitor.hpp>
-#include <gpiod.hpp>
+#include <gpio_event_hub.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <timer_wheel.hpp>
 
+#include <array>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace host_error_monitor::base_gpio_poll_monitor
 {
@@ -33,72 +39,156 @@ enum class AssertValue
     highAssert = 1,
 };
 
+enum class PollMode
+{
+    // Re-read the line every pollingTimeMs while it is asserted
+    interval,
+    // Arm a single timer for timeoutMs on assert and cancel it on deassert
+    deadline,
+};
+
+// A step taken while the line stays asserted, ahead of its timeout
+struct EscalationStage
+{
+    std::string name;
+    size_t thresholdMs;
+    std::function<void()> action;
+    bool enabled;
+    // Set once the stage has run for the current assertion
+    bool done;
+};
+
 class BaseGPIOPollMonitor : public host_error_monitor::base_monitor::BaseMonitor
 {
-    boost::asio::steady_timer pollingTimer;
+    // The polls of every poll monitor share one timer wheel. Deadline mode
+    // stages and timeouts run on an exact timer instead, so they are not
+    // rounded up to a wheel tick.
+    host_error_monitor::timer_wheel::TimerWheel::Timer pollingTimer;
+    host_error_monitor::timer_wheel::ExactTimer deadlineTimer;
+    std::chrono::steady_clock::time_point assertTime;
     std::chrono::steady_clock::time_point timeoutTime;
 
-    gpiod::line line;
-    boost::asio::posix::stream_descriptor event;
+    std::vector<EscalationStage> stages;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> escalationInterface;
+    std::string currentStage = "None";
+
+    host_error_monitor::gpio_line::GPIOLine line;
 
     AssertValue assertValue;
+    PollMode pollMode;
     size_t pollingTimeMs;
     size_t timeoutMs;
+    bool waitingForEvent = false;
+    // Kernel timestamp of the latest assert edge, kept until an assertion
+    // starts from it
+    std::optional<std::chrono::nanoseconds> assertEdge;
 
     virtual void logEvent() {}
 
     bool requestEvents()
     {
-        line = gpiod::find_line(signalName);
-        if (!line)
+        line = host_error_monitor::gpio_event_hub::getHub(io).requestEvents(
+            signalName, assertValue == AssertValue::lowAssert,
+            std::chrono::microseconds(0), [this]() { handleEvent(); });
+        return static_cast<bool>(line);
+    }
+
+    bool asserted()
+    {
+        if constexpr (debug)
         {
-            std::cerr << "Failed to find the " << signalName << " line\n";
-            return false;
+            std::cerr << "Checking " << signalName << " state\n";
         }
 
-        try
+        if (hostIsOff())
         {
-            line.request(
-                {"host-error-monitor", gpiod::line_request::EVENT_BOTH_EDGES,
-                 assertValue == AssertValue::highAssert
-                     ? 0
-                     : gpiod::line_request::FLAG_ACTIVE_LOW});
+            if constexpr (debug)
+            {
+                std::cerr << "Host is off\n";
+            }
+            return false;
         }
-        catch (std::exception&)
+
+        std::error_code ec;
+        bool value = line.getValue(ec);
+        if (ec)
         {
-            std::cerr << "Failed to request events for " << signalName << "\n";
-            return false;
+            std::cerr << "Failed to read " << signalName
+                      << " value: " << ec.message() << "\n";
         }
+        return value;
+    }
 
-        int lineFd = line.event_get_fd();
-        if (lineFd < 0)
+    void setStage(const std::string& stage)
+    {
+        if (stage == currentStage)
         {
-            std::cerr << "Failed to get " << signalName << " fd\n";
-            return false;
+            return;
         }
+        // Every stage but None is part of an assertion
+        if ((currentStage == "None") != (stage == "None"))
+        {
+            setSummaryAsserted(stage != "None");
+        }
+        currentStage = stage;
+        escalationInterface->set_property("Stage", currentStage);
+    }
 
-        event.assign(lineFd);
+    // Get the earliest stage still to run for this assertion. Stages at or
+    // past the timeout never run.
+    std::optional<size_t> nextStage() const
+    {
+        std::optional<size_t> next;
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            const EscalationStage& stage = stages[i];
+            if (!stage.enabled || stage.done || stage.thresholdMs >= timeoutMs)
+            {
+                continue;
+            }
+            if (!next || stage.thresholdMs < stages[*next].thresholdMs)
+            {
+                next = i;
+            }
+        }
+        return next;
+    }
 
-        return true;
+    std::chrono::steady_clock::time_point stageTime(size_t stage) const
+    {
+        return assertTime +
+               std::chrono::milliseconds(stages[stage].thresholdMs);
     }
 
-    bool asserted()
+    void runStage(size_t index)
     {
-        if constexpr (debug)
+        EscalationStage& stage = stages[index];
+        stage.done = true;
+        std::cerr << signalName << " asserted for " << stage.thresholdMs
+                  << " ms, escalating to " << stage.name << "\n";
+        setStage(stage.name);
+        if (stage.action)
         {
-            std::cerr << "Checking " << signalName << " state\n";
+            stage.action();
         }
+    }
 
-        if (hostIsOff())
+    // Measure the latencies of a new assertion from its assert edge
+    void claimEdge()
+    {
+        if (assertEdge)
         {
-            if constexpr (debug)
-            {
-                std::cerr << "Host is off\n";
-            }
-            return false;
+            recordEdge(*assertEdge);
+            assertEdge.reset();
         }
+    }
 
-        return (line.get_value());
+    void deasserted()
+    {
+        clearEdge();
+        assertEdge.reset();
+        setStage("None");
+        deassertHandler();
     }
 
   public:
@@ -111,25 +201,99 @@ class BaseGPIOPollMonitor : public host_error_monitor::base_monitor::BaseMonitor
 
     virtual void deassertHandler() {}
 
+    // Called when a deadline is first armed for an assertion, ahead of its
+    // timeout
+    virtual void assertStarted() {}
+
+    // Called when the line reaches a stage added by addWarningStage().
+    // Early warnings go to the journal only, not to Redfish.
+    virtual void logStageWarning(size_t thresholdMs)
+    {
+        log_message(LOG_WARNING,
+                    signalName + " asserted for " +
+                        std::to_string(thresholdMs) + " ms",
+                    "", "");
+    }
+
+  protected:
+    /** @brief Add a stage that runs while the line stays asserted. Stages run
+     *         in threshold order from the monitor's deadline timer or polls,
+     *         so they add no wakeups of their own.
+     *  @param[in] name - Stage name published while it is the latest stage
+     *  @param[in] thresholdMs - Time from the assert to the stage
+     *  @param[in] action - Called when the stage is reached
+     *  @return Index of the stage
+     */
+    size_t addEscalationStage(const std::string& name, size_t thresholdMs,
+                              std::function<void()> action)
+    {
+        stages.push_back({name, thresholdMs, std::move(action), true, false});
+        return stages.size() - 1;
+    }
+
+    /** @brief Add a Warning stage that logs through logStageWarning()
+     *  @param[in] thresholdMs - Time from the assert to the warning
+     *  @return Index of the stage
+     */
+    size_t addWarningStage(size_t thresholdMs)
+    {
+        return addEscalationStage("Warning", thresholdMs,
+                                  [this, thresholdMs]() {
+                                      logStageWarning(thresholdMs);
+                                  });
+    }
+
+    /** @brief Move a stage. It takes effect when the next deadline is armed.
+     *  @param[in] stage - Index of the stage
+     *  @param[in] thresholdMs - Time from the assert to the stage
+     */
+    void setEscalationThresholdMs(size_t stage, size_t thresholdMs)
+    {
+        stages[stage].thresholdMs = thresholdMs;
+    }
+
+    /** @brief Enable or disable a stage. It takes effect when the next
+     *         deadline is armed.
+     *  @param[in] stage - Index of the stage
+     *  @param[in] enabled - False to skip the stage
+     */
+    void setEscalationEnabled(size_t stage, bool enabled)
+    {
+        stages[stage].enabled = enabled;
+    }
+
   private:
-    void flushEvents()
+    // Returns the kernel timestamp of the last assert edge flushed, if any
+    std::optional<std::chrono::nanoseconds> flushEvents()
     {
         if constexpr (debug)
         {
             std::cerr << "Flushing " << signalName << " events\n";
         }
 
-        while (true)
+        std::optional<std::chrono::nanoseconds> assertTimestamp;
+        std::array<host_error_monitor::gpio_line::LineEvent,
+                   host_error_monitor::gpio_line::GPIOLine::eventBufferSize>
+            events;
+        std::error_code ec;
+        size_t count = 0;
+        do
         {
-            try
-            {
-                line.event_read();
-            }
-            catch (std::system_error&)
+            count = line.readEvents(events, ec);
+            for (size_t i = 0; i < count; i++)
             {
-                break;
+                if (events[i].asserted)
+                {
+                    assertTimestamp = events[i].timestamp;
+                }
             }
+        } while (count == events.size());
+        if (ec)
+        {
+            std::cerr << signalName << " event flush failed: " << ec.message()
+                      << "\n";
         }
+        return assertTimestamp;
     }
 
     void waitForEvent()
@@ -139,38 +303,129 @@ class BaseGPIOPollMonitor : public host_error_monitor::base_monitor::BaseMonitor
             std::cerr << "Wait for " << signalName << "\n";
         }
 
-        event.async_wait(
-            boost::asio::posix::stream_descriptor::wait_read,
-            [this](const boost::system::error_code ec) {
-                if (ec)
-                {
-                    // operation_aborted is expected if wait is canceled.
-                    if (ec != boost::asio::error::operation_aborted)
-                    {
-                        std::cerr << signalName
-                                  << " wait error: " << ec.message() << "\n";
-                    }
-                    return;
-                }
+        waitingForEvent = true;
+    }
 
-                if constexpr (debug)
-                {
-                    std::cerr << signalName << " event ready\n";
-                }
+    void handleEvent()
+    {
+        if constexpr (debug)
+        {
+            std::cerr << signalName << " event ready\n";
+        }
 
-                startPolling();
-            });
+        // The line state is read back after the flush, so any number of
+        // queued edges collapse into a single check
+        std::optional<std::chrono::nanoseconds> assertTimestamp =
+            flushEvents();
+
+        // While interval polling is running it reads the line state itself
+        if (pollMode == PollMode::interval && !waitingForEvent)
+        {
+            return;
+        }
+        waitingForEvent = false;
+        if (assertTimestamp)
+        {
+            assertEdge = assertTimestamp;
+        }
+        startPolling();
     }
 
   public:
     virtual void startPolling()
     {
-        timeoutTime = std::chrono::steady_clock::now() +
-                      std::chrono::duration<int, std::milli>(timeoutMs);
+        if (pollMode == PollMode::deadline)
+        {
+            armDeadline();
+            return;
+        }
+        startAssertion();
         poll();
     }
 
   private:
+    // Start the timeout and the stages of a new assertion
+    void startAssertion()
+    {
+        assertTime = std::chrono::steady_clock::now();
+        timeoutTime = assertTime +
+                      std::chrono::duration<int, std::milli>(timeoutMs);
+        for (EscalationStage& stage : stages)
+        {
+            stage.done = false;
+        }
+    }
+
+    void armDeadline()
+    {
+        if (!asserted())
+        {
+            if constexpr (debug)
+            {
+                std::cerr << signalName << " not asserted\n";
+            }
+
+            deadlineTimer.cancel();
+            deasserted();
+        }
+        else
+        {
+            if constexpr (debug)
+            {
+                std::cerr << signalName << " asserted, timeout in "
+                          << timeoutMs << " ms\n";
+            }
+
+            // Edges during an assertion, such as a glitch that deasserts and
+            // reasserts the line within one wakeup, keep its deadline
+            if (currentStage != "None" && deadlineTimer.pending())
+            {
+                return;
+            }
+
+            claimEdge();
+            startAssertion();
+            assertStarted();
+            setStage("Asserted");
+            scheduleDeadline();
+        }
+    }
+
+    // Arm the one timer for the next stage or, once every stage has run, for
+    // the timeout. Any previously armed deadline is replaced.
+    void scheduleDeadline()
+    {
+        std::optional<size_t> stage = nextStage();
+        if (stage)
+        {
+            deadlineTimer.schedule(stageTime(*stage), [this, stage]() {
+                if (!asserted())
+                {
+                    deasserted();
+                    return;
+                }
+                runStage(*stage);
+                scheduleDeadline();
+            });
+            return;
+        }
+
+        deadlineTimer.schedule(timeoutTime, [this]() {
+            // The deassert edge may still be queued behind the timer, so
+            // confirm the line state before declaring a timeout
+            if (asserted())
+            {
+                setStage("Timeout");
+                recordAssertHandlerEntry();
+                assertHandler();
+            }
+            else
+            {
+                deasserted();
+            }
+        });
+    }
+
     void poll()
     {
         if constexpr (debug)
@@ -187,7 +442,7 @@ class BaseGPIOPollMonitor : public host_error_monitor::base_monitor::BaseMonitor
                 std::cerr << signalName << " not asserted\n";
             }
 
-            deassertHandler();
+            deasserted();
             waitForEvent();
             return;
         }
@@ -196,50 +451,65 @@ class BaseGPIOPollMonitor : public host_error_monitor::base_monitor::BaseMonitor
             std::cerr << signalName << " asserted\n";
         }
 
-        if (std::chrono::steady_clock::now() > timeoutTime)
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        if (currentStage == "None")
+        {
+            claimEdge();
+            setStage("Asserted");
+        }
+        for (std::optional<size_t> stage = nextStage();
+             stage && now >= stageTime(*stage); stage = nextStage())
+        {
+            runStage(*stage);
+        }
+
+        if (now > timeoutTime)
         {
+            setStage("Timeout");
+            recordAssertHandlerEntry();
             assertHandler();
             waitForEvent();
             return;
         }
 
-        pollingTimer.expires_after(std::chrono::milliseconds(pollingTimeMs));
-        pollingTimer.async_wait([this](const boost::system::error_code ec) {
-            if (ec)
-            {
-                // operation_aborted is expected if timer is canceled before
-                // completion.
-                if (ec != boost::asio::error::operation_aborted)
-                {
-                    std::cerr << signalName << " polling async_wait failed: "
-                              << ec.message() << "\n";
-                }
-                return;
-            }
-            poll();
-        });
+        pollingTimer.schedule(std::chrono::steady_clock::now() +
+                                  std::chrono::milliseconds(pollingTimeMs),
+                              [this]() { poll(); });
     }
 
   public:
     BaseGPIOPollMonitor(boost::asio::io_context& io,
                         std::shared_ptr<sdbusplus::asio::connection> conn,
                         const std::string& signalName, AssertValue assertValue,
-                        size_t pollingTimeMs, size_t timeoutMs) :
-        BaseMonitor(io, conn, signalName), pollingTimer(io), event(io),
-        assertValue(assertValue), pollingTimeMs(pollingTimeMs),
-        timeoutMs(timeoutMs)
+                        size_t pollingTimeMs, size_t timeoutMs,
+                        PollMode pollMode = PollMode::interval) :
+        BaseMonitor(io, conn, signalName),
+        pollingTimer(host_error_monitor::timer_wheel::getTimerWheel(io)),
+        deadlineTimer(io),
+        assertValue(assertValue), pollMode(pollMode),
+        pollingTimeMs(pollingTimeMs), timeoutMs(timeoutMs)
     {
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        escalationInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/" + signalName,
+            "xyz.openbmc_project.HostErrorMonitor.Escalation");
+        escalationInterface->register_property("Stage", currentStage);
+        publisher.initialize(escalationInterface);
+
         if (!requestEvents())
         {
             return;
         }
-        event.non_blocking(true);
         valid = true;
     }
 
     void hostOn() override
     {
-        event.cancel();
+        clearEdge();
+        assertEdge.reset();
+        waitingForEvent = false;
         startPolling();
     }
 
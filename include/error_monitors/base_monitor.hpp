@@ -17,10 +17,18 @@
 #include <systemd/sd-journal.h>
 
 #include <boost/asio/io_context.hpp>
+#include <dbus_objects.hpp>
+#include <error_summary.hpp>
+#include <gpio_line.hpp>
+#include <latency_histogram.hpp>
+#include <log_queue.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 #include <xyz/openbmc_project/Logging/Entry/common.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <optional>
+#include <utility>
 
 namespace host_error_monitor::base_monitor
 {
@@ -34,6 +42,55 @@ class BaseMonitor
 
     std::string signalName;
 
+  private:
+    using LatencyHistogram =
+        host_error_monitor::latency_histogram::LatencyHistogram;
+
+    // Kernel timestamp of the edge that started the current assertion. It is
+    // cleared when the signal deasserts.
+    std::optional<std::chrono::nanoseconds> edgeTimestamp;
+    // The same edge until the first log of the assertion is recorded, so
+    // later logs are never measured against it
+    std::optional<std::chrono::nanoseconds> logEdgeTimestamp;
+
+    // Latency from the edge to assertHandler entry, log_message completion
+    // and recovery dispatch
+    LatencyHistogram assertLatency;
+    LatencyHistogram logLatency;
+    LatencyHistogram recoveryLatency;
+
+    std::shared_ptr<sdbusplus::asio::dbus_interface> statisticsInterface;
+
+    // Index of this signal in the error summary
+    size_t summarySignal;
+
+    static void recordLatency(LatencyHistogram& histogram,
+                              std::optional<std::chrono::nanoseconds> edge)
+    {
+        if (!edge)
+        {
+            return;
+        }
+        histogram.record(host_error_monitor::gpio_line::eventClockNow() -
+                         *edge);
+    }
+
+    void registerLatencyProperties(const std::string& name,
+                                   const LatencyHistogram& histogram)
+    {
+        statisticsInterface->register_property_r(
+            name + "LatencyCounts", std::vector<uint64_t>{},
+            sdbusplus::vtable::property_::none,
+            [&histogram](const std::vector<uint64_t>&) {
+                return histogram.getCounts();
+            });
+        statisticsInterface->register_property_r(
+            name + "LatencyMaxUs", uint64_t(0),
+            sdbusplus::vtable::property_::none,
+            [&histogram](const uint64_t&) { return histogram.getMaxUs(); });
+    }
+
+  public:
     BaseMonitor(boost::asio::io_context& io,
                 std::shared_ptr<sdbusplus::asio::connection> conn,
                 const std::string& signalName) :
@@ -41,6 +98,22 @@ class BaseMonitor
 
     {
         std::cerr << "Initializing " << signalName << " Monitor\n";
+
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        statisticsInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/" + signalName,
+            "xyz.openbmc_project.HostErrorMonitor.Statistics");
+        statisticsInterface->register_property(
+            "LatencyBucketBoundsUs", LatencyHistogram::getBucketBoundsUs());
+        registerLatencyProperties("Assert", assertLatency);
+        registerLatencyProperties("Log", logLatency);
+        registerLatencyProperties("Recovery", recoveryLatency);
+        publisher.initialize(statisticsInterface);
+
+        summarySignal =
+            host_error_monitor::error_summary::getErrorSummary(conn).addSignal(
+                signalName);
     }
 
     virtual void hostOn() {}
@@ -50,27 +123,75 @@ class BaseMonitor
         return valid;
     }
 
+    void recordRecoveryDispatch()
+    {
+        recordLatency(recoveryLatency, edgeTimestamp);
+    }
+
   protected:
+    /** @brief Record the edge that started an assertion
+     *  @param[in] timestamp - Kernel timestamp of the assert edge
+     */
+    void recordEdge(std::chrono::nanoseconds timestamp)
+    {
+        edgeTimestamp = timestamp;
+        logEdgeTimestamp = timestamp;
+    }
+
+    // Call when the signal deasserts
+    void clearEdge()
+    {
+        edgeTimestamp.reset();
+        logEdgeTimestamp.reset();
+    }
+
+    void recordAssertHandlerEntry()
+    {
+        recordLatency(assertLatency, edgeTimestamp);
+    }
+
+    /** @brief Set the CPU socket of this signal in the error summary
+     *  @param[in] socket - CPU number of the signal, as used in its logs
+     */
+    void setSummarySocket(size_t socket)
+    {
+        host_error_monitor::error_summary::getErrorSummary(conn).setSocket(
+            summarySignal, static_cast<uint16_t>(socket));
+    }
+
+    void setSummaryAsserted(bool state)
+    {
+        host_error_monitor::error_summary::getErrorSummary(conn).setAsserted(
+            summarySignal, state);
+    }
+
     void log_message(int priority, const std::string& msg,
                      const std::string& redfish_id,
                      const std::string& redfish_msg)
     {
+        // Only the first log of an assertion is measured from its edge
+        std::optional<std::chrono::nanoseconds> edge =
+            std::exchange(logEdgeTimestamp, std::nullopt);
 #ifdef SEND_TO_LOGGING_SERVICE
         (void)redfish_id;
         (void)redfish_msg;
         using namespace sdbusplus::common::xyz::openbmc_project::logging;
-        sdbusplus::message_t newLogEntry = conn->new_method_call(
-            "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
-            "xyz.openbmc_project.Logging.Create", "Create");
-        const std::string logLevel =
-            Entry::convertLevelToString(static_cast<Entry::Level>(priority));
-        newLogEntry.append(msg, std::move(logLevel),
-                           std::map<std::string, std::string>{});
-        conn->call(newLogEntry);
+        // Queued so the event loop never waits on phosphor-logging. The
+        // latency is recorded once the entry is created.
+        host_error_monitor::log_queue::LogQueue::Completion done;
+        if (edge)
+        {
+            done = [this, edge]() { recordLatency(logLatency, edge); };
+        }
+        host_error_monitor::log_queue::getLogQueue(io, conn).push(
+            msg,
+            Entry::convertLevelToString(static_cast<Entry::Level>(priority)),
+            std::move(done));
 #else
         sd_journal_send("MESSAGE=HostError: %s", msg.c_str(), "PRIORITY=%i",
                         priority, "REDFISH_MESSAGE_ID=%s", redfish_id.c_str(),
                         "REDFISH_MESSAGE_ARGS=%s", redfish_msg.c_str(), NULL);
+        recordLatency(logLatency, edge);
 #endif
     }
 };
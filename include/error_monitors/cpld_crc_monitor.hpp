@@ -17,6 +17,7 @@
 #include <systemd/sd-journal.h>
 
 #include <error_monitors/base_gpio_monitor.hpp>
+#include <gpio_input_registry.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 
@@ -29,7 +30,8 @@ class CPLDCRCMonitor :
         assertValue =
             host_error_monitor::base_gpio_monitor::AssertValue::highAssert;
     size_t cpuNum;
-    bool cpuPresent;
+    std::shared_ptr<host_error_monitor::gpio_input_registry::InputLine>
+        cpuPresence;
 
     void logEvent() override
     {
@@ -41,36 +43,17 @@ class CPLDCRCMonitor :
 
     bool getCPUPresence(const std::string& cpuPresenceName)
     {
-        // Find the GPIO line
-        gpiod::line cpuPresenceLine = gpiod::find_line(cpuPresenceName);
-        if (!cpuPresenceLine)
-        {
-            std::cerr << "Failed to find the " << cpuPresenceName << " line.\n";
-            return false;
-        }
-
-        // Request GPIO input
-        try
-        {
-            cpuPresenceLine.request(
-                {"host-error-monitor", gpiod::line_request::DIRECTION_INPUT,
-                 gpiod::line_request::FLAG_ACTIVE_LOW});
-        }
-        catch (std::exception&)
-        {
-            std::cerr << "Failed to request " << cpuPresenceName << " input\n";
-            return false;
-        }
-
-        cpuPresent = cpuPresenceLine.get_value();
-
-        return true;
+        // Share the presence input with the other monitors that read it
+        cpuPresence =
+            host_error_monitor::gpio_input_registry::getRegistry(io).getInput(
+                cpuPresenceName, true);
+        return cpuPresence != nullptr;
     }
 
     void assertHandler() override
     {
         // Ignore this if the CPU is not present
-        if (cpuPresent)
+        if (cpuPresence->asserted())
         {
             host_error_monitor::base_gpio_monitor::BaseGPIOMonitor::
                 assertHandler();
@@ -92,6 +75,7 @@ class CPLDCRCMonitor :
                    const std::string& cpuPresenceName) :
         BaseGPIOMonitor(io, conn, signalName, assertValue), cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         if (!getCPUPresence(cpuPresenceName))
         {
             valid = false;
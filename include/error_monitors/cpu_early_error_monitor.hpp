@@ -42,6 +42,7 @@ class CPUEarlyErrorMonitor :
                          const std::string& signalName, const size_t cpuNum) :
         BaseGPIOMonitor(io, conn, signalName, assertValue), cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         if (valid)
         {
             startMonitoring();
@@ -17,7 +17,7 @@
 #include <systemd/sd-journal.h>
 
 #include <error_monitors/base_monitor.hpp>
-#include <gpiod.hpp>
+#include <gpio_input_registry.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 
@@ -30,7 +30,8 @@ static constexpr bool debug = false;
 class CPUMismatchMonitor : public host_error_monitor::base_monitor::BaseMonitor
 {
     size_t cpuNum;
-    gpiod::line cpuMismatchLine;
+    std::shared_ptr<host_error_monitor::gpio_input_registry::InputLine>
+        cpuMismatch;
 
     void cpuMismatchLog()
     {
@@ -42,28 +43,11 @@ class CPUMismatchMonitor : public host_error_monitor::base_monitor::BaseMonitor
 
     bool requestCPUMismatchInput()
     {
-        // Find the GPIO line
-        cpuMismatchLine = gpiod::find_line(signalName);
-        if (!cpuMismatchLine)
-        {
-            std::cerr << "Failed to find the " << signalName << " line.\n";
-            return false;
-        }
-
         // Request GPIO input
-        try
-        {
-            cpuMismatchLine.request(
-                {"host-error-monitor", gpiod::line_request::DIRECTION_INPUT,
-                 0}); // 0 indicates ACTIVE_HIGH
-        }
-        catch (std::exception&)
-        {
-            std::cerr << "Failed to request " << signalName << " input\n";
-            return false;
-        }
-
-        return true;
+        cpuMismatch =
+            host_error_monitor::gpio_input_registry::getRegistry(io).getInput(
+                signalName, false);
+        return cpuMismatch != nullptr;
     }
 
     bool cpuMismatchAsserted()
@@ -73,7 +57,7 @@ class CPUMismatchMonitor : public host_error_monitor::base_monitor::BaseMonitor
             std::cerr << "Checking " << signalName << " state\n";
         }
 
-        return (cpuMismatchLine.get_value());
+        return cpuMismatch->asserted();
     }
 
     void cpuMismatchAssertHandler()
@@ -84,7 +68,9 @@ class CPUMismatchMonitor : public host_error_monitor::base_monitor::BaseMonitor
 
     void checkCPUMismatch()
     {
-        if (cpuMismatchAsserted())
+        bool mismatch = cpuMismatchAsserted();
+        setSummaryAsserted(mismatch);
+        if (mismatch)
         {
             cpuMismatchAssertHandler();
         }
@@ -96,6 +82,7 @@ class CPUMismatchMonitor : public host_error_monitor::base_monitor::BaseMonitor
                        const std::string& signalName, const size_t cpuNum) :
         BaseMonitor(io, conn, signalName), cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         // Request GPIO input
         if (!requestCPUMismatchInput())
         {
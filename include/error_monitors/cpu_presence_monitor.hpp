@@ -18,7 +18,7 @@
 #include <systemd/sd-journal.h>
 
 #include <error_monitors/base_monitor.hpp>
-#include <gpiod.hpp>
+#include <gpio_input_registry.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 
@@ -26,7 +26,8 @@ namespace host_error_monitor::cpu_presence_monitor
 {
 class CPUPresenceMonitor : public host_error_monitor::base_monitor::BaseMonitor
 {
-    int cpuPresent;
+    std::shared_ptr<host_error_monitor::gpio_input_registry::InputLine>
+        cpuPresence;
     size_t cpuNum;
     const static constexpr uint8_t beepCPUMIssing = 3;
 
@@ -48,36 +49,32 @@ class CPUPresenceMonitor : public host_error_monitor::base_monitor::BaseMonitor
 
     bool getCPUPresence(const std::string& cpuPresenceName)
     {
-        // Find the GPIO line
-        gpiod::line cpuPresenceLine = gpiod::find_line(cpuPresenceName);
-        if (!cpuPresenceLine)
+        // Share the presence input with the other monitors that read it
+        cpuPresence =
+            host_error_monitor::gpio_input_registry::getRegistry(io).getInput(
+                cpuPresenceName, true);
+        if (cpuPresence == nullptr)
         {
-            std::cerr << "Failed to find the " << cpuPresenceName << " line.\n";
             return false;
         }
 
-        // Request GPIO input
-        try
-        {
-            cpuPresenceLine.request(
-                {"host-error-monitor", gpiod::line_request::DIRECTION_INPUT,
-                 gpiod::line_request::FLAG_ACTIVE_LOW});
-        }
-        catch (const std::exception&)
-        {
-            std::cerr << "Failed to request " << cpuPresenceName << " input\n";
-            return false;
-        }
-
-        cpuPresent = cpuPresenceLine.get_value();
-
+        // Report a CPU that is removed while the service is running
+        cpuPresence->addChangeHandler([this](bool present) {
+            setSummaryAsserted(!present);
+            if (!present)
+            {
+                CPUPresenceAssertHandler(conn);
+            }
+        });
         return true;
     }
 
     void checkCPUPresence(std::shared_ptr<sdbusplus::asio::connection> conn)
     {
+        bool present = cpuPresence->asserted();
+        setSummaryAsserted(!present);
         // Ignore this if the CPU present
-        if (!cpuPresent)
+        if (!present)
         {
             CPUPresenceAssertHandler(conn);
         }
@@ -89,6 +86,7 @@ class CPUPresenceMonitor : public host_error_monitor::base_monitor::BaseMonitor
                        const std::string& signalName, const size_t cpuNum) :
         BaseMonitor(io, conn, signalName), cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         if (!getCPUPresence(signalName))
         {
             return;
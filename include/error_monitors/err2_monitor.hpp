@@ -14,11 +14,15 @@
 // limitations under the License.
 */
 #pragma once
+#include <dbus_objects.hpp>
 #include <error_monitors/err_pin_timeout_monitor.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <settings_cache.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <optional>
 
 namespace host_error_monitor::err2_monitor
 {
@@ -30,12 +34,137 @@ class Err2Monitor :
     const static constexpr uint8_t beepCPUErr2 = 5;
 
     std::shared_ptr<sdbusplus::asio::dbus_interface> associationERR2;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> speculativeInterface;
 
     static const constexpr char* callbackMgrPath =
         "/xyz/openbmc_project/CallbackManager";
 
+    // Speculative mode starts the crashdump while ERR2 is still asserted, so
+    // it is already collected, or nearly so, when the timeout commits the
+    // recovery
+    enum class SpeculativeState
+    {
+        // No speculative crashdump
+        idle,
+        // Started before the timeout and still running
+        collecting,
+        // Completed before the timeout
+        collected,
+        // The timeout was reached while the crashdump was running, so the
+        // recovery waits for it to complete
+        committed,
+    };
+
+    const static constexpr size_t speculativeThresholdMsDefault = 30000;
+
+    bool speculativeEnabled = false;
+    size_t speculativeThresholdMs = speculativeThresholdMsDefault;
+    // Escalation stage that starts the speculative crashdump
+    size_t speculativeStage = 0;
+    SpeculativeState speculativeState = SpeculativeState::idle;
+    // Identifies the latest speculative crashdump request, so the completion
+    // of an aborted one is not taken for a later one
+    uint64_t speculativeRequest = 0;
+    // Set once the timeout is reached with a speculative crashdump started,
+    // so a deassert while the recovery setting is read does not abort it
+    bool speculativeTimedOut = false;
+    std::chrono::steady_clock::time_point speculativeStart;
+    std::chrono::steady_clock::time_point speculativeEnd;
+    RecoveryType speculativeRecovery = RecoveryType::noRecovery;
+    uint64_t lastSavedMs = 0;
+    uint64_t totalSavedMs = 0;
+    uint64_t speculativeAborts = 0;
+
+    void startSpeculativeCrashdump()
+    {
+        std::cerr << "Starting a speculative crashdump for " << signalName
+                  << "\n";
+        speculativeState = SpeculativeState::collecting;
+        speculativeStart = std::chrono::steady_clock::now();
+        uint64_t request = ++speculativeRequest;
+        // Taken before the timeout, which may never come, so it is not filed
+        // as an ERR2_Timeout crashdump
+        startCrashdump(conn, "ERR2_Early", [this, request]() {
+            speculativeCrashdumpComplete(request);
+        });
+    }
+
+    void speculativeCrashdumpComplete(uint64_t request)
+    {
+        if (request != speculativeRequest)
+        {
+            // Completion of an earlier, aborted crashdump
+            return;
+        }
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        switch (speculativeState)
+        {
+            case SpeculativeState::idle:
+            case SpeculativeState::collected:
+                // Aborted, the stored log is kept
+                break;
+            case SpeculativeState::collecting:
+                speculativeState = SpeculativeState::collected;
+                speculativeEnd = now;
+                break;
+            case SpeculativeState::committed:
+                // The time saved is how long the crashdump ran before the
+                // timeout
+                recordSpeculativeSavings(speculativeEnd - speculativeStart);
+                speculativeState = SpeculativeState::idle;
+                handleRecovery(speculativeRecovery, conn,
+                               [this]() { recordRecoveryDispatch(); });
+                break;
+        }
+    }
+
+    void recordSpeculativeSavings(std::chrono::steady_clock::duration saved)
+    {
+        lastSavedMs =
+            std::chrono::duration_cast<std::chrono::milliseconds>(saved)
+                .count();
+        totalSavedMs += lastSavedMs;
+        std::cerr << "Speculative crashdump for " << signalName << " saved "
+                  << lastSavedMs << " ms of time to recovery\n";
+        speculativeInterface->set_property("LastSavedMs", lastSavedMs);
+        speculativeInterface->set_property("TotalSavedMs", totalSavedMs);
+    }
+
+    // Commit a speculative crashdump at the timeout. Returns false if none
+    // was started.
+    bool commitSpeculativeCrashdump(
+        RecoveryType recovery, std::chrono::steady_clock::time_point timeout)
+    {
+        speculativeTimedOut = false;
+        switch (speculativeState)
+        {
+            case SpeculativeState::idle:
+            case SpeculativeState::committed:
+                return false;
+            case SpeculativeState::collecting:
+                speculativeState = SpeculativeState::committed;
+                speculativeRecovery = recovery;
+                speculativeEnd = timeout;
+                return true;
+            case SpeculativeState::collected:
+                recordSpeculativeSavings(speculativeEnd - speculativeStart);
+                speculativeState = SpeculativeState::idle;
+                handleRecovery(recovery, conn,
+                               [this]() { recordRecoveryDispatch(); });
+                return true;
+        }
+        return false;
+    }
+
     void assertHandler() override
     {
+        std::chrono::steady_clock::time_point timeout =
+            std::chrono::steady_clock::now();
+        speculativeTimedOut =
+            speculativeState == SpeculativeState::collecting ||
+            speculativeState == SpeculativeState::collected;
+
         host_error_monitor::err_pin_timeout_monitor::ErrPinTimeoutMonitor::
             assertHandler();
 
@@ -43,29 +172,24 @@ class Err2Monitor :
 
         beep(conn, beepCPUErr2);
 
-        conn->async_method_call(
-            [this](boost::system::error_code ec,
-                   const std::variant<bool>& property) {
+        // Settings are cached, so the recovery is decided without a D-Bus
+        // round trip
+        host_error_monitor::settings_cache::SettingsObject& settings =
+            host_error_monitor::settings_cache::getProcessorErrorConfig(conn);
+        settings.get<bool>(
+            "ResetOnERR2", [this, timeout](std::optional<bool> reset) {
                 // Default to no reset after Crashdump
-                RecoveryType recovery = RecoveryType::noRecovery;
-                if (!ec)
+                RecoveryType recovery = reset.value_or(false)
+                                            ? RecoveryType::warmReset
+                                            : RecoveryType::noRecovery;
+                if (commitSpeculativeCrashdump(recovery, timeout))
                 {
-                    const bool* resetPtr = std::get_if<bool>(&property);
-                    if (resetPtr == nullptr)
-                    {
-                        std::cerr << "Unable to read reset on ERR2 value\n";
-                    }
-                    else if (*resetPtr)
-                    {
-                        recovery = RecoveryType::warmReset;
-                    }
+                    return;
                 }
-                startCrashdumpAndRecovery(conn, recovery, "ERR2_Timeout");
-            },
-            "xyz.openbmc_project.Settings",
-            "/xyz/openbmc_project/control/processor_error_config",
-            "org.freedesktop.DBus.Properties", "Get",
-            "xyz.openbmc_project.Control.Processor.ErrConfig", "ResetOnERR2");
+                startCrashdumpAndRecovery(
+                    conn, recovery, "ERR2_Timeout",
+                    [this]() { recordRecoveryDispatch(); });
+            });
     }
 
     void deassertHandler() override
@@ -73,6 +197,20 @@ class Err2Monitor :
         ErrPinTimeoutMonitor::deassertHandler();
 
         unsetLED();
+
+        if (!speculativeTimedOut &&
+            (speculativeState == SpeculativeState::collecting ||
+             speculativeState == SpeculativeState::collected))
+        {
+            // The crashdump service cannot cancel a crashdump, so the
+            // stored log is kept but no recovery follows
+            std::cerr << signalName
+                      << " deasserted before its timeout, aborting the "
+                         "speculative crashdump\n";
+            speculativeState = SpeculativeState::idle;
+            speculativeAborts++;
+            speculativeInterface->set_property("Aborts", speculativeAborts);
+        }
     }
 
     void setLED()
@@ -106,13 +244,53 @@ class Err2Monitor :
         std::vector<host_error_monitor::Association> associations;
         associations.emplace_back("", "", "");
 
-        sdbusplus::asio::object_server server =
-            sdbusplus::asio::object_server(conn);
-        associationERR2 =
-            server.add_interface("/xyz/openbmc_project/host_error_monitor/err2",
-                                 "xyz.openbmc_project.Association.Definitions");
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        associationERR2 = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/err2",
+            "xyz.openbmc_project.Association.Definitions");
         associationERR2->register_property("Associations", associations);
-        associationERR2->initialize();
+        publisher.initialize(associationERR2);
+
+        speculativeStage = addEscalationStage(
+            "SpeculativeCrashdump", speculativeThresholdMs, [this]() {
+                if (speculativeState == SpeculativeState::idle)
+                {
+                    startSpeculativeCrashdump();
+                }
+            });
+        setEscalationEnabled(speculativeStage, speculativeEnabled);
+
+        speculativeInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/err2",
+            "xyz.openbmc_project.HostErrorMonitor.SpeculativeCrashdump");
+        speculativeInterface->register_property(
+            "Enabled", speculativeEnabled,
+            [this](const bool& requested, bool& resp) {
+                speculativeEnabled = requested;
+                setEscalationEnabled(speculativeStage, speculativeEnabled);
+                resp = requested;
+                return 1;
+            });
+        speculativeInterface->register_property(
+            "ThresholdMs", speculativeThresholdMs,
+            [this](const size_t& requested, size_t& resp) {
+                if (requested >= getTimeoutMs())
+                {
+                    std::cerr << "ThresholdMs update to " << requested
+                              << "ms rejected. Must be less than the "
+                              << getTimeoutMs() << "ms timeout.\n";
+                    return 0;
+                }
+                speculativeThresholdMs = requested;
+                setEscalationThresholdMs(speculativeStage, requested);
+                resp = requested;
+                return 1;
+            });
+        speculativeInterface->register_property("LastSavedMs", lastSavedMs);
+        speculativeInterface->register_property("TotalSavedMs", totalSavedMs);
+        speculativeInterface->register_property("Aborts", speculativeAborts);
+        publisher.initialize(speculativeInterface);
     }
 };
 } // namespace host_error_monitor::err2_monitor
@@ -37,7 +37,16 @@ class ErrPinMonitor :
 
     void logEvent()
     {
-        checkErrPinCPUs(errPin, errPinCPUs);
+        // The CPUs are triaged over PECI without blocking other monitors
+        checkErrPinCPUs(io, errPin,
+                        [this](const std::bitset<MAX_CPUS>& assertedCPUs) {
+                            errPinCPUs = assertedCPUs;
+                            logErrPinCPUs();
+                        });
+    }
+
+    void logErrPinCPUs()
+    {
         if (errPinCPUs.none())
         {
             return errPinLog();
@@ -18,6 +18,8 @@
 
 #include <error_monitors/base_gpio_poll_monitor.hpp>
 #include <host_error_monitor.hpp>
+#include <peci_worker.hpp>
+#include <register_snapshot.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 
 #include <bitset>
@@ -36,6 +38,10 @@ class ErrPinTimeoutMonitor :
             host_error_monitor::base_gpio_poll_monitor::AssertValue::lowAssert;
     const static constexpr size_t errPinPollingTimeMs = 1000;
     const static constexpr size_t errPinTimeoutMs = 90000;
+    const static constexpr size_t errPinWarningMs = 5000;
+
+    // First look at the error registers at assert and at timeout
+    host_error_monitor::register_snapshot::RegisterSnapshots snapshots;
 
     void logEvent() override
     {
@@ -68,21 +74,41 @@ class ErrPinTimeoutMonitor :
         log_message(LOG_INFO, msg, "OpenBMC.0.1.CPUError", msg);
     }
 
-    void startPolling() override
+  protected:
+    void assertStarted() override
+    {
+        // The timeout is long enough for the triage to finish before it
+        // expires
+        checkErrPinCPUs(io, errPin,
+                        [this](const std::bitset<MAX_CPUS>& assertedCPUs) {
+                            errPinCPUs = assertedCPUs;
+                        });
+        snapshots.capture(
+            host_error_monitor::register_snapshot::Stage::atAssert);
+    }
+
+    void assertHandler() override
     {
-        checkErrPinCPUs(errPin, errPinCPUs);
+        snapshots.capture(
+            host_error_monitor::register_snapshot::Stage::atTimeout);
         host_error_monitor::base_gpio_poll_monitor::BaseGPIOPollMonitor::
-            startPolling();
+            assertHandler();
     }
 
   public:
     ErrPinTimeoutMonitor(boost::asio::io_context& io,
                          std::shared_ptr<sdbusplus::asio::connection> conn,
                          const std::string& signalName, const size_t errPin) :
-        BaseGPIOPollMonitor(io, conn, signalName, assertValue,
-                            errPinPollingTimeMs, errPinTimeoutMs),
-        errPin(errPin)
+        BaseGPIOPollMonitor(
+            io, conn, signalName, assertValue, errPinPollingTimeMs,
+            errPinTimeoutMs,
+            host_error_monitor::base_gpio_poll_monitor::PollMode::deadline),
+        errPin(errPin),
+        snapshots(io, conn, signalName,
+                  host_error_monitor::peci_worker::Priority::errPin)
     {
+        addWarningStage(errPinWarningMs);
+
         if (valid)
         {
             startPolling();
@@ -16,14 +16,92 @@
 #pragma once
 #include <systemd/sd-journal.h>
 
+#include <cpu_error_counters.hpp>
+#include <cpu_registers.hpp>
+#include <dbus_objects.hpp>
 #include <error_monitors/base_gpio_poll_monitor.hpp>
 #include <host_error_monitor.hpp>
+#include <peci_access.hpp>
+#include <peci_worker.hpp>
+#include <register_snapshot.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <settings_cache.hpp>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace host_error_monitor::ierr_monitor
 {
 static constexpr bool debug = true;
 
+// A CPU that reported the IERR
+struct CPUIERR
+{
+    size_t cpu;
+    // Cause found by the triage. Empty if no specific cause was found and
+    // unset if the triage could not finish.
+    std::optional<std::string> type;
+};
+
+// Blocking IERR triage of one CPU. Runs on the PECI worker thread, so it
+// only returns what it finds for the monitor to report.
+static inline std::optional<CPUIERR> checkIERRCPU(const CPUInfo& cpuInfo)
+{
+    // Keep the PECI device open for all of this socket's reads
+    host_error_monitor::peci_access::Sequence sequence(
+        host_error_monitor::peci_access::getPECIAccess());
+    std::optional<std::optional<std::string>> type =
+        host_error_monitor::cpu_registers::decodeIERR(cpuInfo.addr,
+                                                      cpuInfo.model);
+    if (!type)
+    {
+        return std::nullopt;
+    }
+    // TODO: Light the CPU fault LED?
+    return CPUIERR{cpuInfo.cpu, *type};
+}
+
+// Triage every CPU. In parallel mode each socket's register reads run
+// concurrently with the other sockets' reads.
+static inline std::vector<CPUIERR> checkIERRCPUs(bool parallel)
+{
+    std::vector<CPUIERR> ierrCPUs;
+    std::vector<CPUInfo> cpus = getCPUIDCache().getCPUs();
+    if (!parallel)
+    {
+        for (const CPUInfo& cpuInfo : cpus)
+        {
+            std::optional<CPUIERR> ierr = checkIERRCPU(cpuInfo);
+            if (ierr)
+            {
+                ierrCPUs.push_back(*ierr);
+            }
+        }
+        return ierrCPUs;
+    }
+
+    std::vector<std::future<std::optional<CPUIERR>>> results;
+    for (const CPUInfo& cpuInfo : cpus)
+    {
+        results.push_back(
+            std::async(std::launch::async, checkIERRCPU, cpuInfo));
+    }
+    // Merge in socket order so the report matches the serial triage
+    for (std::future<std::optional<CPUIERR>>& result : results)
+    {
+        std::optional<CPUIERR> ierr = result.get();
+        if (ierr)
+        {
+            ierrCPUs.push_back(*ierr);
+        }
+    }
+    return ierrCPUs;
+}
+
 class IERRMonitor :
     public host_error_monitor::base_gpio_poll_monitor::BaseGPIOPollMonitor
 {
@@ -44,11 +122,78 @@ class IERRMonitor :
     static const constexpr char* callbackMgrPath =
         "/xyz/openbmc_project/CallbackManager";
 
+    // Triage the sockets concurrently instead of one after another. Off by
+    // default: tests/triage_benchmark only shows a win when each command is
+    // slow, and its mock lets commands overlap where the PECI bus does not.
+    bool parallelTriage = false;
+    // Time from the start of the last triage to its results being ready
+    uint64_t lastTriageTimeUs = 0;
+
+    // First look at the error registers at assert and at timeout
+    host_error_monitor::register_snapshot::RegisterSnapshots snapshots;
+
     void logEvent() override
     {
-        if (!checkIERRCPUs())
+        // The crashdump is requested once the CPUs are triaged, so its PECI
+        // traffic never races the triage reads of the error registers
+#ifdef LIBPECI
+        if (!hostIsOff())
         {
-            cpuIERRLog();
+            bool parallel = parallelTriage;
+            std::chrono::steady_clock::time_point triageStart =
+                std::chrono::steady_clock::now();
+            host_error_monitor::peci_worker::getPECIWorker(io).submit(
+                [parallel]() { return checkIERRCPUs(parallel); },
+                [this, parallel,
+                 triageStart](const std::vector<CPUIERR>& ierrCPUs) {
+                    recordTriageTime(parallel, triageStart);
+                    logIERRCPUs(ierrCPUs);
+                    requestCrashdump();
+                },
+                host_error_monitor::peci_worker::Priority::ierr);
+            return;
+        }
+#endif
+        cpuIERRLog();
+        requestCrashdump();
+    }
+
+    void recordTriageTime(bool parallel,
+                          std::chrono::steady_clock::time_point triageStart)
+    {
+        lastTriageTimeUs =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - triageStart)
+                .count();
+        std::cerr << (parallel ? "Parallel" : "Serial")
+                  << " IERR triage took " << lastTriageTimeUs << " us\n";
+        assertIERR->set_property("LastTriageTimeUs", lastTriageTimeUs);
+    }
+
+    void logIERRCPUs(const std::vector<CPUIERR>& ierrCPUs)
+    {
+        if (ierrCPUs.empty())
+        {
+            return cpuIERRLog();
+        }
+
+        for (const CPUIERR& ierr : ierrCPUs)
+        {
+            host_error_monitor::cpu_error_counters::getCPUErrorCounters(io,
+                                                                        conn)
+                .increment(ierr.cpu);
+            if (!ierr.type)
+            {
+                continue;
+            }
+            if (ierr.type->empty())
+            {
+                cpuIERRLog(ierr.cpu);
+            }
+            else
+            {
+                cpuIERRLog(ierr.cpu, *ierr.type);
+            }
         }
     }
 
@@ -71,287 +216,12 @@ class IERRMonitor :
         log_message(LOG_INFO, msg, "OpenBMC.0.1.CPUError", msg);
     }
 
-    bool checkIERRCPUs()
-    {
-        bool cpuIERRFound = false;
-#ifdef LIBPECI
-        for (size_t cpu = 0, addr = MIN_CLIENT_ADDR; addr <= MAX_CLIENT_ADDR;
-             cpu++, addr++)
-        {
-            EPECIStatus peciStatus = PECI_CC_SUCCESS;
-            uint8_t cc = 0;
-            CPUModel model{};
-            uint8_t stepping = 0;
-            if (peci_GetCPUID(addr, &model, &stepping, &cc) != PECI_CC_SUCCESS)
-            {
-                std::cerr << "Cannot get CPUID!\n";
-                continue;
-            }
-
-            switch (model)
-            {
-                case skylake:
-                {
-                    // First check the MCA_ERR_SRC_LOG to see if this is the CPU
-                    // that caused the IERR
-                    uint32_t mcaErrSrcLog = 0;
-                    peciStatus = peci_RdPkgConfig(addr, 0, 5, 4,
-                                                  (uint8_t*)&mcaErrSrcLog, &cc);
-                    if (peciError(peciStatus, cc))
-                    {
-                        printPECIError("MCA_ERR_SRC_LOG", addr, peciStatus, cc);
-                        continue;
-                    }
-                    // Check MSMI_INTERNAL (20) and IERR_INTERNAL (27)
-                    if ((mcaErrSrcLog & (1 << 20)) ||
-                        (mcaErrSrcLog & (1 << 27)))
-                    {
-                        // TODO: Light the CPU fault LED?
-                        cpuIERRFound = true;
-                        incrementCPUErrorCount(cpu);
-                        // Next check if it's a CPU/VR mismatch by reading the
-                        // IA32_MC4_STATUS MSR (0x411)
-                        uint64_t mc4Status = 0;
-                        peciStatus =
-                            peci_RdIAMSR(addr, 0, 0x411, &mc4Status, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("IA32_MC4_STATUS", addr, peciStatus,
-                                           cc);
-                            continue;
-                        }
-                        // Check MSEC bits 31:24 for
-                        // MCA_SVID_VCCIN_VR_ICC_MAX_FAILURE (0x40),
-                        // MCA_SVID_VCCIN_VR_VOUT_FAILURE (0x42), or
-                        // MCA_SVID_CPU_VR_CAPABILITY_ERROR (0x43)
-                        uint64_t msec = (mc4Status >> 24) & 0xFF;
-                        if (msec == 0x40 || msec == 0x42 || msec == 0x43)
-                        {
-                            cpuIERRLog(cpu, "CPU/VR Mismatch");
-                            continue;
-                        }
-
-                        // Next check if it's a Core FIVR fault by looking for a
-                        // non-zero value of CORE_FIVR_ERR_LOG (B(1) D30 F2
-                        // offset 80h)
-                        uint32_t coreFIVRErrLog = 0;
-                        peciStatus = peci_RdPCIConfigLocal(
-                            addr, 1, 30, 2, 0x80, sizeof(uint32_t),
-                            (uint8_t*)&coreFIVRErrLog, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("CORE_FIVR_ERR_LOG", addr,
-                                           peciStatus, cc);
-                            continue;
-                        }
-                        if (coreFIVRErrLog)
-                        {
-                            cpuIERRLog(cpu, "Core FIVR Fault");
-                            continue;
-                        }
-
-                        // Next check if it's an Uncore FIVR fault by looking
-                        // for a non-zero value of UNCORE_FIVR_ERR_LOG (B(1) D30
-                        // F2 offset 84h)
-                        uint32_t uncoreFIVRErrLog = 0;
-                        peciStatus = peci_RdPCIConfigLocal(
-                            addr, 1, 30, 2, 0x84, sizeof(uint32_t),
-                            (uint8_t*)&uncoreFIVRErrLog, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("UNCORE_FIVR_ERR_LOG", addr,
-                                           peciStatus, cc);
-                            continue;
-                        }
-                        if (uncoreFIVRErrLog)
-                        {
-                            cpuIERRLog(cpu, "Uncore FIVR Fault");
-                            continue;
-                        }
-
-                        // Last if CORE_FIVR_ERR_LOG and UNCORE_FIVR_ERR_LOG are
-                        // both zero, but MSEC bits 31:24 have either
-                        // MCA_FIVR_CATAS_OVERVOL_FAULT (0x51) or
-                        // MCA_FIVR_CATAS_OVERCUR_FAULT (0x52), then log it as
-                        // an uncore FIVR fault
-                        if (!coreFIVRErrLog && !uncoreFIVRErrLog &&
-                            (msec == 0x51 || msec == 0x52))
-                        {
-                            cpuIERRLog(cpu, "Uncore FIVR Fault");
-                            continue;
-                        }
-                        cpuIERRLog(cpu);
-                    }
-                    break;
-                }
-                case iceLake:
-                {
-                    // First check the MCA_ERR_SRC_LOG to see if this is the CPU
-                    // that caused the IERR
-                    uint32_t mcaErrSrcLog = 0;
-                    peciStatus = peci_RdPkgConfig(addr, 0, 5, 4,
-                                                  (uint8_t*)&mcaErrSrcLog, &cc);
-                    if (peciError(peciStatus, cc))
-                    {
-                        printPECIError("MCA_ERR_SRC_LOG", addr, peciStatus, cc);
-                        continue;
-                    }
-                    // Check MSMI_INTERNAL (20) and IERR_INTERNAL (27)
-                    if ((mcaErrSrcLog & (1 << 20)) ||
-                        (mcaErrSrcLog & (1 << 27)))
-                    {
-                        // TODO: Light the CPU fault LED?
-                        cpuIERRFound = true;
-                        incrementCPUErrorCount(cpu);
-                        // Next check if it's a CPU/VR mismatch by reading the
-                        // IA32_MC4_STATUS MSR (0x411)
-                        uint64_t mc4Status = 0;
-                        peciStatus =
-                            peci_RdIAMSR(addr, 0, 0x411, &mc4Status, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("IA32_MC4_STATUS", addr, peciStatus,
-                                           cc);
-                            continue;
-                        }
-                        // Check MSEC bits 31:24 for
-                        // MCA_SVID_VCCIN_VR_ICC_MAX_FAILURE (0x40),
-                        // MCA_SVID_VCCIN_VR_VOUT_FAILURE (0x42), or
-                        // MCA_SVID_CPU_VR_CAPABILITY_ERROR (0x43)
-                        uint64_t msec = (mc4Status >> 24) & 0xFF;
-                        if (msec == 0x40 || msec == 0x42 || msec == 0x43)
-                        {
-                            cpuIERRLog(cpu, "CPU/VR Mismatch");
-                            continue;
-                        }
-
-                        // Next check if it's a Core FIVR fault by looking for a
-                        // non-zero value of CORE_FIVR_ERR_LOG (B(31) D30 F2
-                        // offsets C0h and C4h) (Note: Bus 31 is accessed on
-                        // PECI as bus 14)
-                        uint32_t coreFIVRErrLog0 = 0;
-                        uint32_t coreFIVRErrLog1 = 0;
-                        peciStatus = peci_RdEndPointConfigPciLocal(
-                            addr, 0, 14, 30, 2, 0xC0, sizeof(uint32_t),
-                            (uint8_t*)&coreFIVRErrLog0, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("CORE_FIVR_ERR_LOG_0", addr,
-                                           peciStatus, cc);
-                            continue;
-                        }
-                        peciStatus = peci_RdEndPointConfigPciLocal(
-                            addr, 0, 14, 30, 2, 0xC4, sizeof(uint32_t),
-                            (uint8_t*)&coreFIVRErrLog1, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("CORE_FIVR_ERR_LOG_1", addr,
-                                           peciStatus, cc);
-                            continue;
-                        }
-                        if (coreFIVRErrLog0 || coreFIVRErrLog1)
-                        {
-                            cpuIERRLog(cpu, "Core FIVR Fault");
-                            continue;
-                        }
-
-                        // Next check if it's an Uncore FIVR fault by looking
-                        // for a non-zero value of UNCORE_FIVR_ERR_LOG (B(31)
-                        // D30 F2 offset 84h) (Note: Bus 31 is accessed on PECI
-                        // as bus 14)
-                        uint32_t uncoreFIVRErrLog = 0;
-                        peciStatus = peci_RdEndPointConfigPciLocal(
-                            addr, 0, 14, 30, 2, 0x84, sizeof(uint32_t),
-                            (uint8_t*)&uncoreFIVRErrLog, &cc);
-                        if (peciError(peciStatus, cc))
-                        {
-                            printPECIError("UNCORE_FIVR_ERR_LOG", addr,
-                                           peciStatus, cc);
-                            continue;
-                        }
-                        if (uncoreFIVRErrLog)
-                        {
-                            cpuIERRLog(cpu, "Uncore FIVR Fault");
-                            continue;
-                        }
-
-                        // TODO: Update MSEC/MSCOD_31_24 check
-                        // Last if CORE_FIVR_ERR_LOG and UNCORE_FIVR_ERR_LOG are
-                        // both zero, but MSEC bits 31:24 have either
-                        // MCA_FIVR_CATAS_OVERVOL_FAULT (0x51) or
-                        // MCA_FIVR_CATAS_OVERCUR_FAULT (0x52), then log it as
-                        // an uncore FIVR fault
-                        if (!coreFIVRErrLog0 && !coreFIVRErrLog1 &&
-                            !uncoreFIVRErrLog && (msec == 0x51 || msec == 0x52))
-                        {
-                            cpuIERRLog(cpu, "Uncore FIVR Fault");
-                            continue;
-                        }
-                        cpuIERRLog(cpu);
-                    }
-                    break;
-                }
-                default:
-                    std::cerr << "No special IERR handling provided for model "
-                              << static_cast<int>(model) << "\n";
-                    break;
-            }
-        }
-#endif
-        return cpuIERRFound;
-    }
-
-    void incrementCPUErrorCount(int cpuNum)
-    {
-        std::string propertyName = "ErrorCountCPU" + std::to_string(cpuNum + 1);
-
-        // Get the current count
-        conn->async_method_call(
-            [this, propertyName](boost::system::error_code ec,
-                                 const std::variant<uint8_t>& property) {
-                if (ec)
-                {
-                    std::cerr << "Failed to read " << propertyName << ": "
-                              << ec.message() << "\n";
-                    return;
-                }
-                const uint8_t* errorCountVariant =
-                    std::get_if<uint8_t>(&property);
-                if (errorCountVariant == nullptr)
-                {
-                    std::cerr << propertyName << " invalid\n";
-                    return;
-                }
-                uint8_t errorCount = *errorCountVariant;
-                if (errorCount == std::numeric_limits<uint8_t>::max())
-                {
-                    std::cerr << "Maximum error count reached\n";
-                    return;
-                }
-                // Increment the count
-                errorCount++;
-                conn->async_method_call(
-                    [propertyName](boost::system::error_code ec) {
-                        if (ec)
-                        {
-                            std::cerr << "Failed to set " << propertyName
-                                      << ": " << ec.message() << "\n";
-                        }
-                    },
-                    "xyz.openbmc_project.Settings",
-                    "/xyz/openbmc_project/control/processor_error_config",
-                    "org.freedesktop.DBus.Properties", "Set",
-                    "xyz.openbmc_project.Control.Processor.ErrConfig",
-                    propertyName, std::variant<uint8_t>{errorCount});
-            },
-            "xyz.openbmc_project.Settings",
-            "/xyz/openbmc_project/control/processor_error_config",
-            "org.freedesktop.DBus.Properties", "Get",
-            "xyz.openbmc_project.Control.Processor.ErrConfig", propertyName);
-    }
-
     void assertHandler() override
     {
+        snapshots.capture(
+            host_error_monitor::register_snapshot::Stage::atTimeout);
+
+        // This also starts the triage, which then requests the crashdump
         host_error_monitor::base_gpio_poll_monitor::BaseGPIOPollMonitor::
             assertHandler();
 
@@ -359,30 +229,20 @@ class IERRMonitor :
         assertIERR->set_property("Asserted", true);
 
         beep(conn, beepCPUIERR);
+    }
 
-        conn->async_method_call(
-            [this](boost::system::error_code ec,
-                   const std::variant<bool>& property) {
-                // Default to no reset after Crashdump
-                RecoveryType recovery = RecoveryType::noRecovery;
-                if (!ec)
-                {
-                    const bool* resetPtr = std::get_if<bool>(&property);
-                    if (resetPtr == nullptr)
-                    {
-                        std::cerr << "Unable to read reset on IERR value\n";
-                    }
-                    else if (*resetPtr)
-                    {
-                        recovery = RecoveryType::warmReset;
-                    }
-                }
-                startCrashdumpAndRecovery(conn, recovery, "IERR");
-            },
-            "xyz.openbmc_project.Settings",
-            "/xyz/openbmc_project/control/processor_error_config",
-            "org.freedesktop.DBus.Properties", "Get",
-            "xyz.openbmc_project.Control.Processor.ErrConfig", "ResetOnIERR");
+    void requestCrashdump()
+    {
+        host_error_monitor::settings_cache::SettingsObject& settings =
+            host_error_monitor::settings_cache::getProcessorErrorConfig(conn);
+        settings.get<bool>("ResetOnIERR", [this](std::optional<bool> reset) {
+            // Default to no reset after Crashdump
+            RecoveryType recovery = reset.value_or(false)
+                                        ? RecoveryType::warmReset
+                                        : RecoveryType::noRecovery;
+            startCrashdumpAndRecovery(conn, recovery, "IERR",
+                                      [this]() { recordRecoveryDispatch(); });
+        });
     }
 
     void deassertHandler() override
@@ -416,22 +276,25 @@ class IERRMonitor :
                 std::shared_ptr<sdbusplus::asio::connection> conn,
                 const std::string& signalName,
                 const std::string& customName = std::string()) :
-        BaseGPIOPollMonitor(io, conn, signalName, assertValue,
-                            ierrPollingTimeMs, ierrTimeoutMs)
+        BaseGPIOPollMonitor(
+            io, conn, signalName, assertValue, ierrPollingTimeMs, ierrTimeoutMs,
+            host_error_monitor::base_gpio_poll_monitor::PollMode::deadline),
+        snapshots(io, conn, signalName,
+                  host_error_monitor::peci_worker::Priority::ierr)
     {
         // Associations interface for led status
         std::vector<host_error_monitor::Association> associations;
         associations.emplace_back("", "", "");
 
-        sdbusplus::asio::object_server server =
-            sdbusplus::asio::object_server(conn);
-        associationIERR =
-            server.add_interface("/xyz/openbmc_project/host_error_monitor/ierr",
-                                 "xyz.openbmc_project.Association.Definitions");
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        associationIERR = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/ierr",
+            "xyz.openbmc_project.Association.Definitions");
         associationIERR->register_property("Associations", associations);
-        associationIERR->initialize();
+        publisher.initialize(associationIERR);
 
-        hostErrorTimeoutIface = server.add_interface(
+        hostErrorTimeoutIface = publisher.addInterface(
             "/xyz/openbmc_project/host_error_monitor",
             "xyz.openbmc_project.HostErrorMonitor.Timeout");
 
@@ -451,14 +314,22 @@ class IERRMonitor :
                 return 1;
             },
             [this](std::size_t& /*resp*/) { return getTimeoutMs(); });
-        hostErrorTimeoutIface->initialize();
+        publisher.initialize(hostErrorTimeoutIface);
 
         std::string objectName = customName.empty() ? signalName : customName;
-        assertIERR = server.add_interface(
+        assertIERR = publisher.addInterface(
             "/xyz/openbmc_project/host_error_monitor/processor/" + objectName,
             "xyz.openbmc_project.HostErrorMonitor.Processor.IERR");
         assertIERR->register_property("Asserted", false);
-        assertIERR->initialize();
+        assertIERR->register_property(
+            "ParallelTriage", parallelTriage,
+            [this](const bool& requested, bool& resp) {
+                parallelTriage = requested;
+                resp = requested;
+                return 1;
+            });
+        assertIERR->register_property("LastTriageTimeUs", lastTriageTimeUs);
+        publisher.initialize(assertIERR);
 
         if (valid)
         {
@@ -41,8 +41,10 @@ class MCERRMonitor :
         const size_t cpuNum) :
         BaseGPIOMonitor(io, conn, signalName, assertValue), cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         if (valid)
         {
+            enableChatterSuppression();
             startMonitoring();
         }
     }
@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 #pragma once
+#include <dbus_objects.hpp>
 #include <error_monitors/base_gpio_monitor.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
@@ -50,16 +51,17 @@ class MemThermtripMonitor :
                         const std::string& customName = std::string()) :
         BaseGPIOMonitor(io, conn, signalName, assertValue), cpuNum(cpuNum)
     {
-        sdbusplus::asio::object_server server =
-            sdbusplus::asio::object_server(conn);
+        setSummarySocket(cpuNum);
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
         std::string objectName = customName.empty() ? signalName : customName;
         std::string path =
             "/xyz/openbmc_project/host_error_monitor/processor/" + objectName;
 
-        assertInterface = server.add_interface(
+        assertInterface = publisher.addInterface(
             path, "xyz.openbmc_project.HostErrorMonitor.Processor.ThermalTrip");
         assertInterface->register_property("Asserted", false);
-        assertInterface->initialize();
+        publisher.initialize(assertInterface);
         if (valid)
         {
             startMonitoring();
@@ -42,10 +42,15 @@ class MemhotMonitor :
     MemhotMonitor(boost::asio::io_context& io,
                   std::shared_ptr<sdbusplus::asio::connection> conn,
                   const std::string& signalName, const size_t cpuNum) :
-        BaseGPIOMonitor(io, conn, signalName, assertValue), cpuNum(cpuNum)
+        BaseGPIOMonitor(
+            io, conn, signalName, assertValue,
+            host_error_monitor::base_gpio_monitor::noisyLineDebounce),
+        cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         if (valid)
         {
+            enableChatterSuppression();
             startMonitoring();
         }
     }
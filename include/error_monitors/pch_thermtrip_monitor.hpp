@@ -14,6 +14,7 @@
 // limitations under the License.
 */
 #pragma once
+#include <dbus_objects.hpp>
 #include <error_monitors/base_gpio_monitor.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
@@ -83,14 +84,14 @@ class PCHThermtripMonitor :
         std::vector<host_error_monitor::Association> associations;
         associations.emplace_back("", "", "");
 
-        sdbusplus::asio::object_server server =
-            sdbusplus::asio::object_server(conn);
-        associationPCHThermtrip = server.add_interface(
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        associationPCHThermtrip = publisher.addInterface(
             "/xyz/openbmc_project/host_error_monitor/ssb_thermal_trip",
             "xyz.openbmc_project.Association.Definitions");
         associationPCHThermtrip->register_property("Associations",
                                                    associations);
-        associationPCHThermtrip->initialize();
+        publisher.initialize(associationPCHThermtrip);
 
         if (valid)
         {
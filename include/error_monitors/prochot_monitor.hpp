@@ -44,8 +44,10 @@ class ProchotMonitor :
                    const std::string& signalName, const size_t cpuNum) :
         BaseGPIOMonitor(io, conn, signalName, assertValue), cpuNum(cpuNum)
     {
+        setSummarySocket(cpuNum);
         if (valid)
         {
+            enableChatterSuppression();
             startMonitoring();
         }
     }
@@ -19,8 +19,10 @@
 #include <error_monitors/base_gpio_poll_monitor.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <settings_cache.hpp>
 
 #include <iostream>
+#include <optional>
 
 namespace host_error_monitor::smi_monitor
 {
@@ -34,6 +36,7 @@ class SMIMonitor :
             host_error_monitor::base_gpio_poll_monitor::AssertValue::lowAssert;
     const static constexpr size_t smiPollingTimeMs = 1000;
     const static constexpr size_t smiTimeoutMs = 90000;
+    const static constexpr size_t smiWarningMs = 5000;
 
     void logEvent() override
     {
@@ -45,48 +48,34 @@ class SMIMonitor :
     {
         BaseGPIOPollMonitor::assertHandler();
 
-        conn->async_method_call(
-            [this](boost::system::error_code ec,
-                   const std::variant<bool>& property) {
+        host_error_monitor::settings_cache::getResetDisables(conn).get<bool>(
+            "ResetOnSMI", [this](std::optional<bool> resetSetting) {
                 // Default to no reset after Crashdump
-                bool reset = false;
-                if (!ec)
-                {
-                    const bool* resetPtr = std::get_if<bool>(&property);
-                    if (resetPtr == nullptr)
-                    {
-                        std::cerr << "Unable to read reset on " << signalName
-                                  << " value\n";
-                    }
-                    else
-                    {
-                        reset = *resetPtr;
-                    }
-                }
+                bool reset = resetSetting.value_or(false);
 #ifdef HOST_ERROR_CRASHDUMP_ON_SMI_TIMEOUT
                 startCrashdumpAndRecovery(conn, reset, "SMI Timeout");
 #else
                 if (reset)
                 {
+                    recordRecoveryDispatch();
                     std::cout << "Recovering the system\n";
                     startWarmReset(conn);
                 }
 #endif
-            },
-            "xyz.openbmc_project.Settings",
-            "/xyz/openbmc_project/control/bmc_reset_disables",
-            "org.freedesktop.DBus.Properties", "Get",
-            "xyz.openbmc_project.Control.ResetDisables", "ResetOnSMI");
+            });
     }
 
   public:
     SMIMonitor(boost::asio::io_context& io,
                std::shared_ptr<sdbusplus::asio::connection> conn,
                const std::string& signalName) :
-        BaseGPIOPollMonitor(io, conn, signalName, assertValue, smiPollingTimeMs,
-                            smiTimeoutMs)
+        BaseGPIOPollMonitor(
+            io, conn, signalName, assertValue, smiPollingTimeMs, smiTimeoutMs,
+            host_error_monitor::base_gpio_poll_monitor::PollMode::deadline)
 
     {
+        addWarningStage(smiWarningMs);
+
         if (valid)
         {
             startPolling();
@@ -40,10 +40,14 @@ class VRHotMonitor :
     VRHotMonitor(boost::asio::io_context& io,
                  std::shared_ptr<sdbusplus::asio::connection> conn,
                  const std::string& signalName, const std::string& vrName) :
-        BaseGPIOMonitor(io, conn, signalName, assertValue), vrName(vrName)
+        BaseGPIOMonitor(
+            io, conn, signalName, assertValue,
+            host_error_monitor::base_gpio_monitor::noisyLineDebounce),
+        vrName(vrName)
     {
         if (valid)
         {
+            enableChatterSuppression();
             startMonitoring();
         }
     }
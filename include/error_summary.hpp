@@ -0,0 +1,156 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <dbus_objects.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace host_error_monitor::error_summary
+{
+// Signal name and CPU socket. The socket is the CPU number the monitor
+// reports in its logs, or noSocket for a signal that is not tied to one CPU.
+using Signal = std::tuple<std::string, uint16_t>;
+
+static const constexpr uint16_t noSocket =
+    std::numeric_limits<uint16_t>::max();
+
+static const constexpr char* summaryPath =
+    "/xyz/openbmc_project/host_error_monitor/summary";
+static const constexpr char* summaryInterfaceName =
+    "xyz.openbmc_project.HostErrorMonitor.ErrorSummary";
+
+// The asserted state of every monitored signal in one object, so a client
+// reads the whole error picture with one property read instead of checking
+// each monitor's object. Bit n of the Asserted words (word n / 64, bit
+// n % 64) is the state of signal n in Signals.
+class ErrorSummary
+{
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> summaryInterface;
+
+    std::vector<Signal> signals;
+    std::vector<uint64_t> asserted;
+    // Wall clock time of each signal's last change, or 0 if it never changed
+    std::vector<uint64_t> lastChangeUs;
+    uint64_t changes = 0;
+
+    // Report every changed property in one PropertiesChanged signal
+    void signalProperties(const std::vector<std::string>& names)
+    {
+        if (summaryInterface->is_initialized())
+        {
+            conn->emit_properties_changed(summaryPath, summaryInterfaceName,
+                                          names);
+        }
+    }
+
+  public:
+    explicit ErrorSummary(std::shared_ptr<sdbusplus::asio::connection> conn) :
+        conn(conn)
+    {
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        summaryInterface =
+            publisher.addInterface(summaryPath, summaryInterfaceName);
+        summaryInterface->register_property_r(
+            "Signals", std::vector<Signal>{},
+            sdbusplus::vtable::property_::emits_change,
+            [this](const std::vector<Signal>&) { return signals; });
+        summaryInterface->register_property_r(
+            "Asserted", std::vector<uint64_t>{},
+            sdbusplus::vtable::property_::emits_change,
+            [this](const std::vector<uint64_t>&) { return asserted; });
+        summaryInterface->register_property_r(
+            "LastChangeUs", std::vector<uint64_t>{},
+            sdbusplus::vtable::property_::emits_change,
+            [this](const std::vector<uint64_t>&) { return lastChangeUs; });
+        summaryInterface->register_property_r(
+            "Changes", uint64_t(0), sdbusplus::vtable::property_::emits_change,
+            [this](const uint64_t&) { return changes; });
+        publisher.initialize(summaryInterface);
+    }
+
+    ErrorSummary(const ErrorSummary&) = delete;
+    ErrorSummary& operator=(const ErrorSummary&) = delete;
+
+    /** @brief Add a signal to the summary
+     *  @param[in] name - Signal name
+     *  @return The signal's index in the summary
+     */
+    size_t addSignal(const std::string& name)
+    {
+        signals.emplace_back(name, noSocket);
+        lastChangeUs.push_back(0);
+        if (asserted.size() * 64 < signals.size())
+        {
+            asserted.push_back(0);
+            signalProperties({"Signals", "Asserted", "LastChangeUs"});
+        }
+        else
+        {
+            signalProperties({"Signals", "LastChangeUs"});
+        }
+        return signals.size() - 1;
+    }
+
+    /** @brief Set the CPU socket of a signal
+     *  @param[in] index - Index returned by addSignal()
+     *  @param[in] socket - CPU number of the signal, as the monitor reports
+     *                     it in its logs
+     */
+    void setSocket(size_t index, uint16_t socket)
+    {
+        std::get<uint16_t>(signals[index]) = socket;
+        signalProperties({"Signals"});
+    }
+
+    /** @brief Record an edge of a signal
+     *  @param[in] index - Index returned by addSignal()
+     *  @param[in] state - True if the signal is now asserted
+     */
+    void setAsserted(size_t index, bool state)
+    {
+        uint64_t& word = asserted[index / 64];
+        uint64_t bit = uint64_t(1) << (index % 64);
+        if (((word & bit) != 0) == state)
+        {
+            return;
+        }
+        word ^= bit;
+        lastChangeUs[index] =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        changes++;
+        signalProperties({"Asserted", "LastChangeUs", "Changes"});
+    }
+};
+
+inline ErrorSummary&
+    getErrorSummary(std::shared_ptr<sdbusplus::asio::connection> conn)
+{
+    static ErrorSummary summary(conn);
+    return summary;
+}
+
+} // namespace host_error_monitor::error_summary
@@ -0,0 +1,316 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <gpio_line.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace host_error_monitor::gpio_event_hub
+{
+static constexpr bool debug = false;
+
+// Collects the GPIO line event fds of every monitor into one epoll set per
+// gpiochip, so the io_context only waits on one descriptor per chip
+// regardless of how many signals are monitored on it. With libgpiod v2 the
+// set holds the chip's one line request, which is replaced as lines are
+// added, and its events are read once per wakeup for all of its lines.
+class GPIOEventHub
+{
+  public:
+    using EventHandler = std::function<void()>;
+    using GPIOLine = host_error_monitor::gpio_line::GPIOLine;
+
+  private:
+    static const constexpr size_t maxEventsPerWait = 32;
+
+    struct ChipWatcher
+    {
+        std::string chipName;
+        boost::asio::posix::stream_descriptor epoll;
+        // Event handlers indexed by line offset on this chip
+        std::vector<EventHandler> handlers;
+#ifdef LIBGPIOD_V2
+        std::shared_ptr<host_error_monitor::gpio_line::ChipRequest> chip;
+        bool dispatching = false;
+        bool dispatchAgain = false;
+        bool dispatchPosted = false;
+#endif
+
+        ChipWatcher(boost::asio::io_context& io, const std::string& chipName,
+                    int epollFd, size_t numLines) :
+            chipName(chipName), epoll(io, epollFd), handlers(numLines)
+        {}
+
+#ifdef LIBGPIOD_V2
+        ~ChipWatcher()
+        {
+            if (chip)
+            {
+                chip->setHandlers(nullptr, nullptr);
+            }
+        }
+#endif
+    };
+
+    boost::asio::io_context& io;
+    std::vector<std::unique_ptr<ChipWatcher>> watchers;
+
+    ChipWatcher* getWatcher(const GPIOLine& line)
+    {
+        const std::string& chipName = line.getChipName();
+        for (const std::unique_ptr<ChipWatcher>& watcher : watchers)
+        {
+            if (watcher->chipName == chipName)
+            {
+                return watcher.get();
+            }
+        }
+
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0)
+        {
+            std::cerr << "Failed to create epoll set for " << chipName << ": "
+                      << std::strerror(errno) << "\n";
+            return nullptr;
+        }
+
+        ChipWatcher& watcher = *watchers.emplace_back(
+            std::make_unique<ChipWatcher>(io, chipName, epollFd,
+                                          line.getChipNumLines()));
+#ifdef LIBGPIOD_V2
+        watcher.chip = line.getChipRequest();
+        if (!watch(watcher, line.getFd(), 0))
+        {
+            watchers.pop_back();
+            return nullptr;
+        }
+        watcher.chip->setHandlers(
+            [this, &watcher](int fd) { watch(watcher, fd, 0); },
+            [this, &watcher]() { eventsQueued(watcher); });
+#endif
+        waitForEvents(watcher);
+        return &watcher;
+    }
+
+    /** @brief Add an event fd to a chip's epoll set
+     *  @param[in] watcher - Watcher of the chip
+     *  @param[in] fd - Event fd to watch
+     *  @param[in] offset - Line offset reported when the fd is ready
+     *  @return False if the fd cannot be watched
+     */
+    bool watch(ChipWatcher& watcher, int fd, unsigned int offset)
+    {
+        if (fd < 0)
+        {
+            std::cerr << "Failed to get a " << watcher.chipName << " fd\n";
+            return false;
+        }
+
+        // Events are only read once epoll reports them ready, but a spurious
+        // wakeup must never block the io_context
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            std::cerr << "Failed to set a " << watcher.chipName
+                      << " fd non-blocking\n";
+            return false;
+        }
+
+        epoll_event lineEvent{};
+        lineEvent.events = EPOLLIN;
+        lineEvent.data.u32 = offset;
+        if (epoll_ctl(watcher.epoll.native_handle(), EPOLL_CTL_ADD, fd,
+                      &lineEvent) < 0)
+        {
+            std::cerr << "Failed to watch a " << watcher.chipName
+                      << " fd: " << std::strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+#ifdef LIBGPIOD_V2
+    // Events queued outside of a dispatch, for example edges found when the
+    // lines were requested again, are dispatched from the io_context
+    void eventsQueued(ChipWatcher& watcher)
+    {
+        if (watcher.dispatching)
+        {
+            watcher.dispatchAgain = true;
+            return;
+        }
+        if (watcher.dispatchPosted)
+        {
+            return;
+        }
+        watcher.dispatchPosted = true;
+        boost::asio::post(io, [&watcher, this]() {
+            watcher.dispatchPosted = false;
+            dispatch(watcher);
+        });
+    }
+
+    // Call the handler of every line with queued events. A handler's read
+    // may queue events for other lines, so repeat until none are left.
+    void dispatch(ChipWatcher& watcher)
+    {
+        watcher.dispatching = true;
+        do
+        {
+            watcher.dispatchAgain = false;
+            for (unsigned int offset = 0; offset < watcher.handlers.size();
+                 offset++)
+            {
+                const EventHandler& handler = watcher.handlers[offset];
+                if (handler && watcher.chip->hasEvents(offset))
+                {
+                    handler();
+                }
+            }
+        } while (watcher.dispatchAgain);
+        watcher.dispatching = false;
+    }
+#endif
+
+    void waitForEvents(ChipWatcher& watcher)
+    {
+        if constexpr (debug)
+        {
+            std::cerr << "Wait for " << watcher.chipName << " events\n";
+        }
+
+        watcher.epoll.async_wait(
+            boost::asio::posix::stream_descriptor::wait_read,
+            [this, &watcher](const boost::system::error_code ec) {
+                if (ec)
+                {
+                    // operation_aborted is expected if wait is canceled.
+                    if (ec != boost::asio::error::operation_aborted)
+                    {
+                        std::cerr << watcher.chipName
+                                  << " wait error: " << ec.message() << "\n";
+                    }
+                    return;
+                }
+
+                std::array<epoll_event, maxEventsPerWait> ready;
+                int count = epoll_wait(watcher.epoll.native_handle(),
+                                       ready.data(), ready.size(), 0);
+                if (count < 0 && errno != EINTR)
+                {
+                    std::cerr << watcher.chipName << " epoll_wait failed: "
+                              << std::strerror(errno) << "\n";
+                }
+#ifdef LIBGPIOD_V2
+                if (count > 0)
+                {
+                    // One read takes the events of every line on the chip
+                    std::error_code readEc;
+                    watcher.dispatching = true;
+                    watcher.chip->readAll(readEc);
+                    if (readEc)
+                    {
+                        std::cerr << watcher.chipName << " read failed: "
+                                  << readEc.message() << "\n";
+                    }
+                    dispatch(watcher);
+                }
+#else
+                for (int i = 0; i < count; i++)
+                {
+                    const EventHandler& handler =
+                        watcher.handlers[ready[i].data.u32];
+                    if (handler)
+                    {
+                        handler();
+                    }
+                }
+#endif
+                waitForEvents(watcher);
+            });
+    }
+
+  public:
+    explicit GPIOEventHub(boost::asio::io_context& io) : io(io) {}
+
+    /** @brief Request both-edge events on a GPIO line and watch it
+     *  @param[in] signalName - GPIO name of the line
+     *  @param[in] activeLow - True if the line asserts low
+     *  @param[in] debounce - Kernel debounce period, zero to disable
+     *  @param[in] handler - Called when the line has events ready. It must
+     *                      read the pending events or it will be called
+     *                      again immediately.
+     *  @return The requested line, or an empty line on failure
+     */
+    GPIOLine requestEvents(const std::string& signalName, bool activeLow,
+                           std::chrono::microseconds debounce,
+                           EventHandler handler)
+    {
+        GPIOLine line = host_error_monitor::gpio_line::requestEvents(
+            signalName, activeLow, debounce);
+        if (!line)
+        {
+            return line;
+        }
+
+        // Returning an empty line on failure drops this handle, which
+        // releases the line request
+        ChipWatcher* watcher = getWatcher(line);
+        if (watcher == nullptr)
+        {
+            std::cerr << "Failed to watch " << signalName << "\n";
+            return GPIOLine();
+        }
+
+        unsigned int offset = line.getOffset();
+#ifndef LIBGPIOD_V2
+        // The chip's request fd is already watched on v2
+        if (!watch(*watcher, line.getFd(), offset))
+        {
+            std::cerr << "Failed to watch " << signalName << "\n";
+            return GPIOLine();
+        }
+#endif
+        if (offset >= watcher->handlers.size())
+        {
+            watcher->handlers.resize(offset + 1);
+        }
+        watcher->handlers[offset] = std::move(handler);
+
+        return line;
+    }
+};
+
+inline GPIOEventHub& getHub(boost::asio::io_context& io)
+{
+    static GPIOEventHub hub(io);
+    return hub;
+}
+
+} // namespace host_error_monitor::gpio_event_hub
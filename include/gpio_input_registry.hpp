@@ -0,0 +1,211 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <gpio_event_hub.hpp>
+#include <gpio_line.hpp>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace host_error_monitor::gpio_input_registry
+{
+static constexpr bool debug = false;
+
+// A GPIO input shared by every monitor that reads it. The value is cached
+// and kept current from the line's edge events, so reading it never touches
+// the hardware.
+class InputLine
+{
+  public:
+    using ChangeHandler = std::function<void(bool asserted)>;
+
+  private:
+    std::string signalName;
+    bool activeLow;
+    host_error_monitor::gpio_line::GPIOLine line;
+    bool value = false;
+    // Set once the value has been read or reported by an edge
+    bool valid = false;
+    std::vector<ChangeHandler> changeHandlers;
+
+    std::array<host_error_monitor::gpio_line::LineEvent,
+               host_error_monitor::gpio_line::GPIOLine::eventBufferSize>
+        eventBuffer;
+
+    void handleEvent()
+    {
+        // Only the state after the last queued edge matters
+        bool newValue = value;
+        std::error_code ec;
+        size_t count = 0;
+        do
+        {
+            count = line.readEvents(eventBuffer, ec);
+            if (count > 0)
+            {
+                newValue = eventBuffer[count - 1].asserted;
+                valid = true;
+            }
+        } while (count == eventBuffer.size());
+        if (ec)
+        {
+            std::cerr << "Failed to read " << signalName
+                      << " events: " << ec.message() << "\n";
+        }
+
+        if (newValue == value)
+        {
+            return;
+        }
+        value = newValue;
+
+        if constexpr (debug)
+        {
+            std::cerr << signalName << " changed to " << value << "\n";
+        }
+
+        for (const ChangeHandler& handler : changeHandlers)
+        {
+            handler(value);
+        }
+    }
+
+  public:
+    InputLine(const std::string& signalName, bool activeLow) :
+        signalName(signalName), activeLow(activeLow)
+    {}
+
+    bool request(boost::asio::io_context& io)
+    {
+        line = host_error_monitor::gpio_event_hub::getHub(io).requestEvents(
+            signalName, activeLow, std::chrono::microseconds(0),
+            [this]() { handleEvent(); });
+        return static_cast<bool>(line);
+    }
+
+    bool readValue()
+    {
+        std::error_code ec;
+        value = line.getValue(ec);
+        if (ec)
+        {
+            std::cerr << "Failed to read " << signalName
+                      << " value: " << ec.message() << "\n";
+            return false;
+        }
+        valid = true;
+        return true;
+    }
+
+    /** @brief Check if the cached value is known
+     *  @return False until the value has been read or an edge is reported
+     */
+    bool isValid() const
+    {
+        return valid;
+    }
+
+    bool isActiveLow() const
+    {
+        return activeLow;
+    }
+
+    /** @brief Get the cached line value
+     *  @return True if the line is asserted
+     */
+    bool asserted() const
+    {
+        return value;
+    }
+
+    /** @brief Add a handler to call when the line value changes
+     *  @param[in] handler - Called with the new value
+     */
+    void addChangeHandler(ChangeHandler handler)
+    {
+        changeHandlers.push_back(std::move(handler));
+    }
+};
+
+// Requests each GPIO input once and hands the same InputLine to every
+// monitor that asks for it
+class GPIOInputRegistry
+{
+    boost::asio::io_context& io;
+    std::unordered_map<std::string, std::shared_ptr<InputLine>> inputs;
+
+  public:
+    explicit GPIOInputRegistry(boost::asio::io_context& io) : io(io) {}
+
+    /** @brief Get a shared GPIO input, requesting it on first use
+     *  @param[in] signalName - GPIO name of the line
+     *  @param[in] activeLow - True if the line asserts low
+     *  @return The shared input, or nullptr if it could not be requested or
+     *          its value is not known
+     */
+    std::shared_ptr<InputLine> getInput(const std::string& signalName,
+                                        bool activeLow)
+    {
+        auto it = inputs.find(signalName);
+        if (it != inputs.end())
+        {
+            if (it->second->isActiveLow() != activeLow)
+            {
+                std::cerr << signalName
+                          << " is already requested with a different "
+                             "polarity\n";
+                return nullptr;
+            }
+            // An input whose first read failed is read again, so every
+            // caller only gets an input with a known value
+            if (!it->second->isValid() && !it->second->readValue())
+            {
+                return nullptr;
+            }
+            return it->second;
+        }
+
+        std::shared_ptr<InputLine> input =
+            std::make_shared<InputLine>(signalName, activeLow);
+        if (!input->request(io))
+        {
+            return nullptr;
+        }
+        // The event hub now holds a handler for this input, so keep it alive
+        // even if the initial read fails
+        inputs.emplace(signalName, input);
+        if (!input->readValue())
+        {
+            return nullptr;
+        }
+        return input;
+    }
+};
+
+inline GPIOInputRegistry& getRegistry(boost::asio::io_context& io)
+{
+    static GPIOInputRegistry registry(io);
+    return registry;
+}
+
+} // namespace host_error_monitor::gpio_input_registry
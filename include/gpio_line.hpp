@@ -0,0 +1,792 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <gpiod.h>
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#ifdef LIBGPIOD_V2
+#include <filesystem>
+#endif
+
+namespace host_error_monitor::gpio_line
+{
+static constexpr const char* consumerName = "host-error-monitor";
+
+struct LineEvent
+{
+    bool asserted;
+    // Kernel timestamp of the edge (CLOCK_MONOTONIC)
+    std::chrono::nanoseconds timestamp;
+};
+
+/** @brief Get the current time on the clock of the edge timestamps, so
+ *         times measured from an edge never mix clocks
+ *  @return Time since boot on CLOCK_MONOTONIC
+ */
+static inline std::chrono::nanoseconds eventClockNow()
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return std::chrono::seconds(now.tv_sec) +
+           std::chrono::nanoseconds(now.tv_nsec);
+}
+
+struct LineLocation
+{
+    std::shared_ptr<gpiod_chip> chip;
+    unsigned int offset;
+};
+
+using LineIndex = std::unordered_map<std::string, LineLocation>;
+
+#ifdef LIBGPIOD_V2
+// Scan every gpiochip once and map each named line to its chip and offset
+static inline LineIndex buildLineIndex()
+{
+    LineIndex index;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator("/dev"))
+    {
+        if (!gpiod_is_gpiochip_device(entry.path().c_str()))
+        {
+            continue;
+        }
+        std::shared_ptr<gpiod_chip> chip(gpiod_chip_open(entry.path().c_str()),
+                                         gpiod_chip_close);
+        if (!chip)
+        {
+            continue;
+        }
+        std::unique_ptr<gpiod_chip_info, decltype(&gpiod_chip_info_free)>
+            info(gpiod_chip_get_info(chip.get()), gpiod_chip_info_free);
+        if (!info)
+        {
+            continue;
+        }
+        size_t numLines = gpiod_chip_info_get_num_lines(info.get());
+        for (unsigned int offset = 0; offset < numLines; offset++)
+        {
+            std::unique_ptr<gpiod_line_info, decltype(&gpiod_line_info_free)>
+                lineInfo(gpiod_chip_get_line_info(chip.get(), offset),
+                         gpiod_line_info_free);
+            if (!lineInfo)
+            {
+                continue;
+            }
+            const char* name = gpiod_line_info_get_name(lineInfo.get());
+            if (name != nullptr)
+            {
+                index.try_emplace(name, LineLocation{chip, offset});
+            }
+        }
+    }
+    return index;
+}
+#else
+// Scan every gpiochip once and map each named line to its chip and offset
+static inline LineIndex buildLineIndex()
+{
+    LineIndex index;
+    gpiod_chip_iter* iter = gpiod_chip_iter_new();
+    if (iter == nullptr)
+    {
+        std::cerr << "Failed to iterate GPIO chips\n";
+        return index;
+    }
+    for (gpiod_chip* rawChip = gpiod_chip_iter_next_noclose(iter);
+         rawChip != nullptr; rawChip = gpiod_chip_iter_next_noclose(iter))
+    {
+        // Chips stay open for the lifetime of the index
+        std::shared_ptr<gpiod_chip> chip(rawChip, gpiod_chip_close);
+        unsigned int numLines = gpiod_chip_num_lines(chip.get());
+        for (unsigned int offset = 0; offset < numLines; offset++)
+        {
+            gpiod_line* line = gpiod_chip_get_line(chip.get(), offset);
+            if (line == nullptr)
+            {
+                continue;
+            }
+            const char* name = gpiod_line_name(line);
+            if (name != nullptr)
+            {
+                index.try_emplace(name, LineLocation{chip, offset});
+            }
+        }
+    }
+    gpiod_chip_iter_free_noclose(iter);
+    return index;
+}
+#endif
+
+/** @brief Get the line name index, building it on first use
+ *  @return Map of every named GPIO line to its chip and offset
+ */
+inline const LineIndex& getLineIndex()
+{
+    static const LineIndex index = buildLineIndex();
+    return index;
+}
+
+/** @brief Look up a GPIO line by name in the line index
+ *  @param[in] signalName - GPIO name of the line
+ *  @return The line's chip and offset, or nullptr if no line has the name
+ */
+static inline const LineLocation* findLine(const std::string& signalName)
+{
+    const LineIndex& index = getLineIndex();
+    LineIndex::const_iterator it = index.find(signalName);
+    if (it == index.end())
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+#ifdef LIBGPIOD_V2
+struct LineSettings
+{
+    bool activeLow;
+    std::chrono::microseconds debounce;
+};
+
+// The one line request of a gpiochip. Every monitored line on the chip is
+// part of it, so the chip costs one fd and its events are read in batches
+// for all of its lines. Events are queued per line until the line's owner
+// reads them. The kernel cannot add lines to a request, so adding a line
+// requests the chip's lines again.
+class ChipRequest
+{
+  public:
+    // The kernel buffers this many events per read from a v2 request
+    static const constexpr size_t eventBufferSize = 64;
+
+  private:
+    struct Line
+    {
+        LineSettings settings;
+        // State after the last event read, to detect edges missed while
+        // the lines are requested again
+        bool asserted = false;
+        std::deque<LineEvent> pending;
+    };
+
+    std::shared_ptr<gpiod_chip> chip;
+    std::string chipName;
+    unsigned int numLines;
+    std::map<unsigned int, Line> lines;
+    std::unique_ptr<gpiod_line_request, decltype(&gpiod_line_request_release)>
+        request{nullptr, gpiod_line_request_release};
+    std::unique_ptr<gpiod_edge_event_buffer,
+                    decltype(&gpiod_edge_event_buffer_free)>
+        eventBuffer;
+    // Called with the new request fd whenever the lines are requested again
+    std::function<void(int)> requestHandler;
+    // Called when events have been queued for the lines
+    std::function<void()> eventHandler;
+
+    void notifyEvents()
+    {
+        if (eventHandler)
+        {
+            eventHandler();
+        }
+    }
+
+    gpiod_line_request*
+        requestLines(const std::map<unsigned int, LineSettings>& settings)
+    {
+        std::unique_ptr<gpiod_line_config, decltype(&gpiod_line_config_free)>
+            lineConfig(gpiod_line_config_new(), gpiod_line_config_free);
+        std::unique_ptr<gpiod_request_config,
+                        decltype(&gpiod_request_config_free)>
+            requestConfig(gpiod_request_config_new(),
+                          gpiod_request_config_free);
+        if (!lineConfig || !requestConfig)
+        {
+            return nullptr;
+        }
+        for (const auto& [offset, lineSettings] : settings)
+        {
+            std::unique_ptr<gpiod_line_settings,
+                            decltype(&gpiod_line_settings_free)>
+                config(gpiod_line_settings_new(), gpiod_line_settings_free);
+            if (!config)
+            {
+                return nullptr;
+            }
+            gpiod_line_settings_set_direction(config.get(),
+                                              GPIOD_LINE_DIRECTION_INPUT);
+            gpiod_line_settings_set_edge_detection(config.get(),
+                                                   GPIOD_LINE_EDGE_BOTH);
+            gpiod_line_settings_set_active_low(config.get(),
+                                               lineSettings.activeLow);
+            gpiod_line_settings_set_event_clock(config.get(),
+                                                GPIOD_LINE_CLOCK_MONOTONIC);
+            if (lineSettings.debounce.count() > 0)
+            {
+                gpiod_line_settings_set_debounce_period_us(
+                    config.get(), lineSettings.debounce.count());
+            }
+            if (gpiod_line_config_add_line_settings(lineConfig.get(), &offset,
+                                                    1, config.get()) < 0)
+            {
+                return nullptr;
+            }
+        }
+        gpiod_request_config_set_consumer(requestConfig.get(), consumerName);
+        gpiod_request_config_set_event_buffer_size(requestConfig.get(),
+                                                   eventBufferSize);
+        return gpiod_chip_request_lines(chip.get(), requestConfig.get(),
+                                        lineConfig.get());
+    }
+
+    std::map<unsigned int, LineSettings> settings() const
+    {
+        std::map<unsigned int, LineSettings> all;
+        for (const auto& [offset, line] : lines)
+        {
+            all.emplace(offset, line.settings);
+        }
+        return all;
+    }
+
+    // Request the chip's lines again with a new set of lines. If that fails,
+    // the previous lines are requested again.
+    bool rerequest(const std::map<unsigned int, LineSettings>& newSettings)
+    {
+        // Keep the events already queued in the kernel
+        std::error_code ec;
+        readAll(ec);
+
+        std::map<unsigned int, LineSettings> requested = newSettings;
+        request.reset();
+        if (!requested.empty())
+        {
+            request.reset(requestLines(requested));
+        }
+        bool success = request || requested.empty();
+        if (!success)
+        {
+            std::cerr << "Failed to request the " << chipName
+                      << " lines: " << std::strerror(errno) << "\n";
+            requested = settings();
+            if (!requested.empty())
+            {
+                request.reset(requestLines(requested));
+            }
+            if (!request && !requested.empty())
+            {
+                std::cerr << "Lost the " << chipName << " lines\n";
+            }
+        }
+        if (!request)
+        {
+            return success;
+        }
+        if (requestHandler)
+        {
+            requestHandler(getFd());
+        }
+
+        // Queue an edge for any line that changed while it was not
+        // requested
+        bool queued = false;
+        for (auto& [offset, line] : lines)
+        {
+            if (!requested.contains(offset))
+            {
+                continue;
+            }
+            bool asserted = getValue(offset, ec);
+            if (!ec && asserted != line.asserted)
+            {
+                line.asserted = asserted;
+                line.pending.push_back({asserted, eventClockNow()});
+            }
+            queued = queued || !line.pending.empty();
+        }
+        if (queued)
+        {
+            notifyEvents();
+        }
+        return success;
+    }
+
+  public:
+    ChipRequest(std::shared_ptr<gpiod_chip> chip, const std::string& chipName,
+                unsigned int numLines) :
+        chip(chip), chipName(chipName), numLines(numLines),
+        eventBuffer(gpiod_edge_event_buffer_new(eventBufferSize),
+                    gpiod_edge_event_buffer_free)
+    {}
+
+    ChipRequest(const ChipRequest&) = delete;
+    ChipRequest& operator=(const ChipRequest&) = delete;
+
+    /** @brief Add a line to the chip's request
+     *  @param[in] signalName - GPIO name of the line
+     *  @param[in] offset - Line offset on the chip
+     *  @param[in] lineSettings - Polarity and debounce of the line
+     *  @return False if the line could not be requested
+     */
+    bool addLine(const std::string& signalName, unsigned int offset,
+                 const LineSettings& lineSettings)
+    {
+        if (!eventBuffer || lines.contains(offset))
+        {
+            std::cerr << "Failed to request " << signalName << "\n";
+            return false;
+        }
+
+        // Check the line on its own first, so a line that cannot be
+        // requested never disturbs the lines already requested
+        std::unique_ptr<gpiod_line_request,
+                        decltype(&gpiod_line_request_release)>
+            probe(requestLines({{offset, lineSettings}}),
+                  gpiod_line_request_release);
+        if (!probe)
+        {
+            std::cerr << "Failed to request " << signalName << ": "
+                      << std::strerror(errno) << "\n";
+            return false;
+        }
+        probe.reset();
+
+        std::map<unsigned int, LineSettings> newSettings = settings();
+        newSettings.emplace(offset, lineSettings);
+        if (!rerequest(newSettings))
+        {
+            return false;
+        }
+        Line& line = lines[offset];
+        line.settings = lineSettings;
+        std::error_code ec;
+        line.asserted = getValue(offset, ec);
+        return true;
+    }
+
+    void removeLine(unsigned int offset)
+    {
+        std::map<unsigned int, LineSettings> newSettings = settings();
+        newSettings.erase(offset);
+        rerequest(newSettings);
+        lines.erase(offset);
+    }
+
+    const std::string& getChipName() const
+    {
+        return chipName;
+    }
+
+    unsigned int getNumLines() const
+    {
+        return numLines;
+    }
+
+    /** @brief Set the callbacks of the chip's watcher
+     *  @param[in] onRequest - Called with the new request fd each time the
+     *                         lines are requested again
+     *  @param[in] onEvents - Called when events have been queued for the
+     *                        lines, including edges found on a new request
+     */
+    void setHandlers(std::function<void(int)> onRequest,
+                     std::function<void()> onEvents)
+    {
+        requestHandler = std::move(onRequest);
+        eventHandler = std::move(onEvents);
+    }
+
+    int getFd() const
+    {
+        return request ? gpiod_line_request_get_fd(request.get()) : -1;
+    }
+
+    bool getValue(unsigned int offset, std::error_code& ec) const
+    {
+        if (!request)
+        {
+            ec = std::make_error_code(std::errc::bad_file_descriptor);
+            return false;
+        }
+        gpiod_line_value value =
+            gpiod_line_request_get_value(request.get(), offset);
+        if (value == GPIOD_LINE_VALUE_ERROR)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return false;
+        }
+        ec.clear();
+        return value == GPIOD_LINE_VALUE_ACTIVE;
+    }
+
+    /** @brief Read every queued event of the chip without blocking and
+     *         queue it on its line
+     *  @param[out] ec - Set if a read failed
+     */
+    void readAll(std::error_code& ec)
+    {
+        ec.clear();
+        if (!request)
+        {
+            return;
+        }
+        int read = 0;
+        bool queued = false;
+        do
+        {
+            read = gpiod_line_request_read_edge_events(
+                request.get(), eventBuffer.get(), eventBufferSize);
+            if (read < 0)
+            {
+                if (errno != EAGAIN)
+                {
+                    ec = std::error_code(errno, std::generic_category());
+                }
+                break;
+            }
+            for (int i = 0; i < read; i++)
+            {
+                gpiod_edge_event* event =
+                    gpiod_edge_event_buffer_get_event(eventBuffer.get(), i);
+                auto line =
+                    lines.find(gpiod_edge_event_get_line_offset(event));
+                if (line == lines.end())
+                {
+                    continue;
+                }
+                // With active-low set, both active-high and active-low
+                // signals have a RISING_EDGE event when asserted
+                LineEvent lineEvent{
+                    gpiod_edge_event_get_event_type(event) ==
+                        GPIOD_EDGE_EVENT_RISING_EDGE,
+                    std::chrono::nanoseconds(
+                        gpiod_edge_event_get_timestamp_ns(event))};
+                line->second.asserted = lineEvent.asserted;
+                // A line whose events are never read keeps only the latest
+                if (line->second.pending.size() >= eventBufferSize)
+                {
+                    line->second.pending.pop_front();
+                }
+                line->second.pending.push_back(lineEvent);
+                queued = true;
+            }
+        } while (static_cast<size_t>(read) == eventBufferSize);
+        if (queued)
+        {
+            notifyEvents();
+        }
+    }
+
+    bool hasEvents(unsigned int offset) const
+    {
+        auto line = lines.find(offset);
+        return line != lines.end() && !line->second.pending.empty();
+    }
+
+    /** @brief Take the queued events of a line
+     *  @param[in] offset - Line offset on the chip
+     *  @param[out] events - Buffer for the events taken
+     *  @return The number of events taken. Zero once the queue is empty.
+     */
+    size_t takeEvents(unsigned int offset, std::span<LineEvent> events)
+    {
+        auto line = lines.find(offset);
+        if (line == lines.end())
+        {
+            return 0;
+        }
+        std::deque<LineEvent>& pending = line->second.pending;
+        size_t count = std::min(events.size(), pending.size());
+        std::copy_n(pending.begin(), count, events.begin());
+        pending.erase(pending.begin(), pending.begin() + count);
+        return count;
+    }
+};
+
+/** @brief Get the line request of a chip, creating it on first use
+ *  @param[in] location - Chip and offset of a line on the chip
+ *  @return The chip's request, or nullptr if the chip has no info
+ */
+static inline std::shared_ptr<ChipRequest>
+    getChipRequest(const LineLocation& location)
+{
+    static std::unordered_map<gpiod_chip*, std::shared_ptr<ChipRequest>>
+        requests;
+    std::shared_ptr<ChipRequest>& request = requests[location.chip.get()];
+    if (request)
+    {
+        return request;
+    }
+    std::unique_ptr<gpiod_chip_info, decltype(&gpiod_chip_info_free)> info(
+        gpiod_chip_get_info(location.chip.get()), gpiod_chip_info_free);
+    if (!info)
+    {
+        requests.erase(location.chip.get());
+        return nullptr;
+    }
+    request = std::make_shared<ChipRequest>(
+        location.chip, gpiod_chip_info_get_name(info.get()),
+        gpiod_chip_info_get_num_lines(info.get()));
+    return request;
+}
+
+// Non-throwing handle to a requested GPIO line. The hot read paths report
+// failures through std::error_code so that draining an empty event queue
+// never throws. The line is removed from its chip's request once the last
+// copy of the handle is gone.
+class GPIOLine
+{
+    std::shared_ptr<ChipRequest> chip;
+    // Removes the line from the chip's request when released
+    std::shared_ptr<void> claim;
+    unsigned int offset = 0;
+
+  public:
+    static const constexpr size_t eventBufferSize =
+        ChipRequest::eventBufferSize;
+
+    GPIOLine() = default;
+    GPIOLine(std::shared_ptr<ChipRequest> chip, unsigned int offset) :
+        chip(chip), claim(nullptr,
+                          [chip, offset](void*) { chip->removeLine(offset); }),
+        offset(offset)
+    {}
+
+    explicit operator bool() const
+    {
+        return chip != nullptr;
+    }
+
+    std::shared_ptr<ChipRequest> getChipRequest() const
+    {
+        return chip;
+    }
+
+    int getFd() const
+    {
+        return chip->getFd();
+    }
+
+    const std::string& getChipName() const
+    {
+        return chip->getChipName();
+    }
+
+    unsigned int getChipNumLines() const
+    {
+        return chip->getNumLines();
+    }
+
+    unsigned int getOffset() const
+    {
+        return offset;
+    }
+
+    bool getValue(std::error_code& ec) const
+    {
+        return chip->getValue(offset, ec);
+    }
+
+    /** @brief Read queued edge events without blocking
+     *  @param[out] events - Buffer for the events read
+     *  @param[out] ec - Set if the read failed
+     *  @return The number of events read. Zero once the queue is empty.
+     */
+    size_t readEvents(std::span<LineEvent> events, std::error_code& ec) const
+    {
+        chip->readAll(ec);
+        return chip->takeEvents(offset, events);
+    }
+};
+
+/** @brief Request both-edge events on a GPIO line
+ *  @param[in] signalName - GPIO name of the line
+ *  @param[in] activeLow - True if the line asserts low
+ *  @param[in] debounce - Kernel debounce period, zero to disable
+ *  @return The requested line, or an empty line on failure
+ */
+static inline GPIOLine requestEvents(const std::string& signalName,
+                                     bool activeLow,
+                                     std::chrono::microseconds debounce)
+{
+    const LineLocation* location = findLine(signalName);
+    if (location == nullptr)
+    {
+        std::cerr << "Failed to find the " << signalName << " line\n";
+        return GPIOLine();
+    }
+    std::shared_ptr<ChipRequest> chip = getChipRequest(*location);
+    if (chip == nullptr)
+    {
+        std::cerr << "Failed to get the " << signalName << " chip\n";
+        return GPIOLine();
+    }
+    if (!chip->addLine(signalName, location->offset, {activeLow, debounce}))
+    {
+        return GPIOLine();
+    }
+    return GPIOLine(chip, location->offset);
+}
+#else
+// Non-throwing handle to a requested GPIO line. The hot read paths report
+// failures through std::error_code so that draining an empty event queue
+// costs a single EAGAIN read rather than a thrown exception.
+class GPIOLine
+{
+    // The line is owned by its chip. Only the request is released once the
+    // last copy of the handle is gone.
+    std::shared_ptr<gpiod_line> line;
+
+  public:
+    // libgpiod reads at most this many events per call
+    static const constexpr size_t eventBufferSize = 16;
+
+    GPIOLine() = default;
+    explicit GPIOLine(gpiod_line* line) : line(line, gpiod_line_release) {}
+
+    explicit operator bool() const
+    {
+        return line != nullptr;
+    }
+
+    int getFd() const
+    {
+        return gpiod_line_event_get_fd(line.get());
+    }
+
+    std::string getChipName() const
+    {
+        return gpiod_chip_name(gpiod_line_get_chip(line.get()));
+    }
+
+    unsigned int getChipNumLines() const
+    {
+        return gpiod_chip_num_lines(gpiod_line_get_chip(line.get()));
+    }
+
+    unsigned int getOffset() const
+    {
+        return gpiod_line_offset(line.get());
+    }
+
+    bool getValue(std::error_code& ec) const
+    {
+        int value = gpiod_line_get_value(line.get());
+        if (value < 0)
+        {
+            ec = std::error_code(errno, std::generic_category());
+            return false;
+        }
+        ec.clear();
+        return value != 0;
+    }
+
+    /** @brief Read queued edge events without blocking
+     *  @param[out] events - Buffer for the events read
+     *  @param[out] ec - Set if the read failed
+     *  @return The number of events read. Zero once the queue is empty.
+     */
+    size_t readEvents(std::span<LineEvent> events, std::error_code& ec) const
+    {
+        std::array<gpiod_line_event, eventBufferSize> rawEvents;
+        size_t count = 0;
+        ec.clear();
+        while (count < events.size())
+        {
+            unsigned int request = static_cast<unsigned int>(
+                std::min(rawEvents.size(), events.size() - count));
+            int read = gpiod_line_event_read_fd_multiple(
+                getFd(), rawEvents.data(), request);
+            if (read < 0)
+            {
+                if (errno != EAGAIN)
+                {
+                    ec = std::error_code(errno, std::generic_category());
+                }
+                break;
+            }
+            for (int i = 0; i < read; i++)
+            {
+                // With FLAG_ACTIVE_LOW enabled, both active-high and
+                // active-low signals have a RISING_EDGE event when asserted
+                events[count].asserted =
+                    rawEvents[i].event_type == GPIOD_LINE_EVENT_RISING_EDGE;
+                events[count].timestamp =
+                    std::chrono::seconds(rawEvents[i].ts.tv_sec) +
+                    std::chrono::nanoseconds(rawEvents[i].ts.tv_nsec);
+                count++;
+            }
+            if (static_cast<unsigned int>(read) < request)
+            {
+                break;
+            }
+        }
+        return count;
+    }
+};
+
+/** @brief Request both-edge events on a GPIO line
+ *  @param[in] signalName - GPIO name of the line
+ *  @param[in] activeLow - True if the line asserts low
+ *  @param[in] debounce - Ignored, the v1 ABI has no debounce support
+ *  @return The requested line, or an empty line on failure
+ */
+static inline GPIOLine requestEvents(const std::string& signalName,
+                                     bool activeLow,
+                                     std::chrono::microseconds /*debounce*/)
+{
+    const LineLocation* location = findLine(signalName);
+    if (location == nullptr)
+    {
+        std::cerr << "Failed to find the " << signalName << " line\n";
+        return GPIOLine();
+    }
+    gpiod_line* line =
+        gpiod_chip_get_line(location->chip.get(), location->offset);
+    if (line == nullptr)
+    {
+        std::cerr << "Failed to get the " << signalName << " line\n";
+        return GPIOLine();
+    }
+
+    if (gpiod_line_request_both_edges_events_flags(
+            line, consumerName,
+            activeLow ? GPIOD_LINE_REQUEST_FLAG_ACTIVE_LOW : 0) < 0)
+    {
+        std::cerr << "Failed to request events for " << signalName << ": "
+                  << std::strerror(errno) << "\n";
+        return GPIOLine();
+    }
+
+    return GPIOLine(line);
+}
+#endif
+
+} // namespace host_error_monitor::gpio_line
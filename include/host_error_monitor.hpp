@@ -20,10 +20,19 @@
 #define MAX_CPUS 8
 #endif
 
+#include <cpu_registers.hpp>
+#include <peci_access.hpp>
+#include <peci_worker.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 
 #include <bitset>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <vector>
 
 namespace host_error_monitor
 {
@@ -74,8 +83,14 @@ enum class RecoveryType
 };
 
 static inline void handleRecovery(
-    RecoveryType recovery, std::shared_ptr<sdbusplus::asio::connection> conn)
+    RecoveryType recovery, std::shared_ptr<sdbusplus::asio::connection> conn,
+    const std::function<void()>& recoveryDispatched = nullptr)
 {
+    if (recoveryDispatched)
+    {
+        recoveryDispatched();
+    }
+
     switch (recovery)
     {
         case RecoveryType::noRecovery:
@@ -93,32 +108,52 @@ static inline void handleRecovery(
     }
 }
 
-static inline void startCrashdumpAndRecovery(
+/** @brief Request a stored crashdump
+ *  @param[in] conn - D-Bus connection
+ *  @param[in] triggerType - Error that triggered the crashdump
+ *  @param[in] completed - Called when the crashdump completes or could not
+ *                         be started
+ */
+static inline void startCrashdump(
     [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn,
-    [[maybe_unused]] RecoveryType requestedRecovery,
-    [[maybe_unused]] const std::string& triggerType)
+    [[maybe_unused]] const std::string& triggerType,
+    [[maybe_unused]] const std::function<void()>& completed)
 {
 #ifdef CRASHDUMP
-    static RecoveryType recovery;
-    recovery = requestedRecovery;
-    std::cerr << "Starting crashdump\n";
+    using Completion = std::shared_ptr<std::function<void()>>;
+    // The completion of every request waiting for the crashdump. Requests
+    // made while a crashdump runs are all completed by its signal.
+    static std::vector<Completion> pendingCompletions;
     static std::shared_ptr<sdbusplus::bus::match_t> crashdumpCompleteMatch;
 
+    std::cerr << "Starting crashdump\n";
+    Completion onComplete = std::make_shared<std::function<void()>>(completed);
+    pendingCompletions.push_back(onComplete);
+
     if (!crashdumpCompleteMatch)
     {
         crashdumpCompleteMatch = std::make_shared<sdbusplus::bus::match_t>(
             *conn,
             "type='signal',interface='com.intel.crashdump',member='"
             "CrashdumpComplete'",
-            [conn](sdbusplus::message_t& /*msg*/) {
+            [](sdbusplus::message_t& /*msg*/) {
                 std::cerr << "Crashdump completed\n";
-                handleRecovery(recovery, conn);
+                std::vector<Completion> completions =
+                    std::move(pendingCompletions);
+                pendingCompletions.clear();
                 crashdumpCompleteMatch.reset();
+                for (const Completion& completion : completions)
+                {
+                    if (*completion)
+                    {
+                        (*completion)();
+                    }
+                }
             });
     }
 
     conn->async_method_call(
-        [conn](boost::system::error_code ec) {
+        [onComplete](boost::system::error_code ec) {
             if (ec)
             {
                 if (ec.value() == boost::system::errc::device_or_resource_busy)
@@ -129,8 +164,17 @@ static inline void startCrashdumpAndRecovery(
                 }
 
                 std::cerr << "failed to start Crashdump\n";
-                handleRecovery(recovery, conn);
-                crashdumpCompleteMatch.reset();
+                // Only this request failed. Others keep waiting for the
+                // signal.
+                std::erase(pendingCompletions, onComplete);
+                if (pendingCompletions.empty())
+                {
+                    crashdumpCompleteMatch.reset();
+                }
+                if (*onComplete)
+                {
+                    (*onComplete)();
+                }
             }
         },
         "com.intel.crashdump", "/com/intel/crashdump",
@@ -138,24 +182,144 @@ static inline void startCrashdumpAndRecovery(
 #endif
 }
 
-#ifdef LIBPECI
-static inline bool peciError(EPECIStatus peciStatus, uint8_t cc)
+static inline void startCrashdumpAndRecovery(
+    std::shared_ptr<sdbusplus::asio::connection> conn,
+    RecoveryType requestedRecovery, const std::string& triggerType,
+    const std::function<void()>& recoveryDispatched = nullptr)
 {
-    return (
-        peciStatus != PECI_CC_SUCCESS ||
-        (cc != PECI_DEV_CC_SUCCESS && cc != PECI_DEV_CC_FATAL_MCA_DETECTED));
+    startCrashdump(conn, triggerType,
+                   [conn, requestedRecovery, recoveryDispatched]() {
+                       handleRecovery(requestedRecovery, conn,
+                                      recoveryDispatched);
+                   });
 }
 
-static void printPECIError(const std::string& reg, const size_t addr,
-                           const EPECIStatus peciStatus, const size_t cc)
+struct CPUInfo
 {
-    std::ios_base::fmtflags originalFlags = std::cerr.flags();
-    std::cerr << "Failed to read " << reg << " on CPU address " << std::dec
-              << addr << ". Error: " << peciStatus << ": cc: 0x" << std::hex
-              << cc << "\n";
-    std::cerr.flags(originalFlags);
+    size_t cpu;
+    uint8_t addr;
+    host_error_monitor::peci_access::Model model;
+    uint8_t stepping;
+};
+
+// CPUID of every present CPU with a supported model. The sockets are probed
+// on first use after a host power transition and the result is shared by
+// all of the triage code until the next transition. The sockets are probed
+// from the PECI worker thread, so the cache is locked.
+class CPUIDCache
+{
+    std::mutex mutex;
+    std::optional<std::vector<CPUInfo>> cpus;
+    // Incremented on every invalidation so a probe that raced with a power
+    // transition is not cached
+    uint64_t generation = 0;
+
+    // Returns false if any socket could not be probed, so the result is only
+    // cached once every socket has given a definite answer
+    static bool probe(std::vector<CPUInfo>& found)
+    {
+        bool complete = true;
+        using host_error_monitor::peci_access::maxClientAddr;
+        using host_error_monitor::peci_access::minClientAddr;
+        using host_error_monitor::peci_access::Status;
+        for (size_t cpu = 0, addr = minClientAddr; addr <= maxClientAddr;
+             cpu++, addr++)
+        {
+            uint8_t cc = 0;
+            host_error_monitor::peci_access::Model model{};
+            uint8_t stepping = 0;
+            Status peciStatus =
+                host_error_monitor::peci_access::getPECIAccess().getCPUID(
+                    addr, &model, &stepping, &cc);
+            if (peciStatus != Status::success)
+            {
+                if (peciStatus != Status::cpuNotPresent)
+                {
+                    host_error_monitor::cpu_registers::printPECIError(
+                        "CPUID", addr, peciStatus, cc);
+                    complete = false;
+                }
+                continue;
+            }
+
+            if (host_error_monitor::cpu_registers::findModel(model) == nullptr)
+            {
+                std::ostringstream msg;
+                msg << "Unsupported CPU Model: 0x" << std::hex
+                    << static_cast<int>(model) << "\n";
+                std::cerr << msg.str();
+                continue;
+            }
+            found.push_back(
+                {cpu, static_cast<uint8_t>(addr), model, stepping});
+        }
+        return complete;
+    }
+
+  public:
+    /** @brief Get the present CPUs with a supported model. Only call this
+     *         from the PECI worker while the host is on.
+     *  @return The cached CPUs, probing them first if needed
+     */
+    std::vector<CPUInfo> getCPUs()
+    {
+        uint64_t probeGeneration = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (cpus)
+            {
+                return *cpus;
+            }
+            probeGeneration = generation;
+        }
+
+        std::vector<CPUInfo> found;
+        if (probe(found))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (generation == probeGeneration)
+            {
+                cpus = found;
+            }
+        }
+        return found;
+    }
+
+    void invalidate()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cpus.reset();
+        generation++;
+    }
+};
+
+inline CPUIDCache& getCPUIDCache()
+{
+    static CPUIDCache cache;
+    return cache;
+}
+
+// Drop the cached CPUIDs so they are probed again after a host power
+// transition
+static inline void invalidateCPUIDCache()
+{
+    getCPUIDCache().invalidate();
 }
+
+/** @brief Probe the CPUIDs on the PECI worker once the host is on, so the
+ *         first triage does not wait for the probe of every socket
+ *  @param[in] io - ASIO io_context
+ */
+static inline void fillCPUIDCache([[maybe_unused]] boost::asio::io_context& io)
+{
+#ifdef LIBPECI
+    host_error_monitor::peci_worker::getPECIWorker(io).submit(
+        []() { return getCPUIDCache().getCPUs().size(); },
+        [](size_t cpus) {
+            std::cerr << "Found " << cpus << " supported CPUs\n";
+        });
 #endif
+}
 
 [[maybe_unused]] static inline void beep(
     std::shared_ptr<sdbusplus::asio::connection> conn,
@@ -175,73 +339,44 @@ static void printPECIError(const std::string& reg, const size_t addr,
         "xyz.openbmc_project.BeepCode", "Beep", uint8_t(beepPriority));
 }
 
+// Blocking ERRx triage. Runs on the PECI worker thread.
+static inline std::bitset<MAX_CPUS> checkErrPinCPUs(const size_t errPin)
+{
+    std::bitset<MAX_CPUS> errPinCPUs;
+    std::vector<CPUInfo> cpus = getCPUIDCache().getCPUs();
+    host_error_monitor::peci_access::Sequence sequence(
+        host_error_monitor::peci_access::getPECIAccess());
+    for (const CPUInfo& cpuInfo : cpus)
+    {
+        // Check the ERRPINSTS to see if this is the CPU that caused the ERRx
+        errPinCPUs[cpuInfo.cpu] = host_error_monitor::cpu_registers::
+            decodeErrPinSts(cpuInfo.addr, cpuInfo.model, errPin);
+    }
+    return errPinCPUs;
+}
+
+/** @brief Find the CPUs that asserted an ERRx pin without blocking
+ *  @param[in] io - ASIO io_context
+ *  @param[in] errPin - ERRx pin number
+ *  @param[in] done - Called on the io_context with the CPUs that asserted the
+ *                    pin. None are set if they cannot be read.
+ */
 [[maybe_unused]] static inline void checkErrPinCPUs(
-    [[maybe_unused]] const size_t errPin, std::bitset<MAX_CPUS>& errPinCPUs)
+    [[maybe_unused]] boost::asio::io_context& io,
+    [[maybe_unused]] const size_t errPin,
+    const std::function<void(const std::bitset<MAX_CPUS>&)>& done)
 {
-    errPinCPUs.reset();
 #ifdef LIBPECI
-    for (size_t cpu = 0, addr = MIN_CLIENT_ADDR; addr <= MAX_CLIENT_ADDR;
-         cpu++, addr++)
+    // The CPUs cannot answer while the host is off
+    if (!hostIsOff())
     {
-        EPECIStatus peciStatus = PECI_CC_SUCCESS;
-        uint8_t cc = 0;
-        CPUModel model{};
-        uint8_t stepping = 0;
-        peciStatus = peci_GetCPUID(addr, &model, &stepping, &cc);
-        if (peciStatus != PECI_CC_SUCCESS)
-        {
-            if (peciStatus != PECI_CC_CPU_NOT_PRESENT)
-            {
-                printPECIError("CPUID", addr, peciStatus, cc);
-            }
-            continue;
-        }
-
-        switch (model)
-        {
-            case skylake:
-            {
-                // Check the ERRPINSTS to see if this is the CPU that
-                // caused the ERRx (B(0) D8 F0 offset 210h)
-                uint32_t errpinsts = 0;
-                peciStatus = peci_RdPCIConfigLocal(addr, 0, 8, 0, 0x210,
-                                                   sizeof(uint32_t),
-                                                   (uint8_t*)&errpinsts, &cc);
-                if (peciError(peciStatus, cc))
-                {
-                    printPECIError("ERRPINSTS", addr, peciStatus, cc);
-                    continue;
-                }
-
-                errPinCPUs[cpu] = (errpinsts & (1 << errPin)) != 0;
-                break;
-            }
-            case iceLake:
-            {
-                // Check the ERRPINSTS to see if this is the CPU that
-                // caused the ERRx (B(30) D0 F3 offset 274h) (Note: Bus
-                // 30 is accessed on PECI as bus 13)
-                uint32_t errpinsts = 0;
-                peciStatus = peci_RdEndPointConfigPciLocal(
-                    addr, 0, 13, 0, 3, 0x274, sizeof(uint32_t),
-                    (uint8_t*)&errpinsts, &cc);
-                if (peciError(peciStatus, cc))
-                {
-                    printPECIError("ERRPINSTS", addr, peciStatus, cc);
-                    continue;
-                }
-
-                errPinCPUs[cpu] = (errpinsts & (1 << errPin)) != 0;
-                break;
-            }
-            default:
-            {
-                std::cerr << "Unsupported CPU Model: 0x" << std::hex
-                          << static_cast<int>(model) << std::dec << "\n";
-            }
-        }
+        host_error_monitor::peci_worker::getPECIWorker(io).submit(
+            [errPin]() { return checkErrPinCPUs(errPin); }, done,
+            host_error_monitor::peci_worker::Priority::errPin);
+        return;
     }
 #endif
+    done(std::bitset<MAX_CPUS>());
 }
 
 } // namespace host_error_monitor
@@ -0,0 +1,72 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace host_error_monitor::latency_histogram
+{
+// Fixed-bucket latency histogram. Recording a sample never allocates.
+class LatencyHistogram
+{
+  public:
+    // Upper bounds of each bucket in microseconds (10us to 1000s). Samples
+    // slower than the last bound are counted in one extra overflow bucket.
+    static constexpr std::array<uint64_t, 24> bucketBoundsUs = {
+        10,        25,        50,         100,        250,       500,
+        1000,      2500,      5000,       10000,      25000,     50000,
+        100000,    250000,    500000,     1000000,    2500000,   5000000,
+        10000000,  25000000,  50000000,   100000000,  250000000, 1000000000};
+
+  private:
+    std::array<uint64_t, bucketBoundsUs.size() + 1> counts{};
+    uint64_t maxUs = 0;
+
+  public:
+    void record(std::chrono::nanoseconds latency)
+    {
+        uint64_t us = static_cast<uint64_t>(std::max(
+            std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                .count(),
+            std::chrono::microseconds::rep(0)));
+        size_t bucket =
+            std::lower_bound(bucketBoundsUs.begin(), bucketBoundsUs.end(), us) -
+            bucketBoundsUs.begin();
+        counts[bucket]++;
+        maxUs = std::max(maxUs, us);
+    }
+
+    std::vector<uint64_t> getCounts() const
+    {
+        return std::vector<uint64_t>(counts.begin(), counts.end());
+    }
+
+    uint64_t getMaxUs() const
+    {
+        return maxUs;
+    }
+
+    static std::vector<uint64_t> getBucketBoundsUs()
+    {
+        return std::vector<uint64_t>(bucketBoundsUs.begin(),
+                                     bucketBoundsUs.end());
+    }
+};
+
+} // namespace host_error_monitor::latency_histogram
@@ -0,0 +1,232 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <dbus_objects.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace host_error_monitor::log_queue
+{
+static constexpr bool debug = false;
+
+// Sends log entries to phosphor-logging without blocking the event loop.
+// Entries are queued and sent with async Create calls, a limited number at
+// a time. Entries logged while one handler runs are sent together once it
+// returns, so a burst never delays the GPIO handling or recovery that
+// produced it. Create takes one entry per call, so a burst is batched by
+// folding each repeat of the last queued entry into it.
+class LogQueue
+{
+  public:
+    // Called once the entry has been created
+    using Completion = std::function<void()>;
+
+  private:
+    struct Entry
+    {
+        std::string msg;
+        std::string level;
+        Completion done;
+        // Times the entry was pushed before it was sent
+        size_t repeats;
+    };
+
+    // Earlier entries are kept over later ones when the queue is full, as
+    // the first errors of a burst usually explain the rest
+    static const constexpr size_t capacity = 256;
+    static const constexpr size_t maxInFlightDefault = 4;
+
+    boost::asio::io_context& io;
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> statisticsInterface;
+
+    std::deque<Entry> queue;
+    size_t inFlight = 0;
+    size_t maxInFlight = maxInFlightDefault;
+    bool sendPosted = false;
+    // Set while entries are being dropped, so each overflow is logged once
+    bool overflowing = false;
+
+    uint64_t sent = 0;
+    uint64_t failed = 0;
+    uint64_t dropped = 0;
+    uint64_t coalesced = 0;
+    uint64_t highWater = 0;
+
+    void send()
+    {
+        if constexpr (debug)
+        {
+            std::cerr << "Sending " << queue.size() << " queued log entries\n";
+        }
+
+        while (inFlight < maxInFlight && !queue.empty())
+        {
+            Entry entry = std::move(queue.front());
+            queue.pop_front();
+            if (entry.repeats > 1)
+            {
+                entry.msg += " (repeated " + std::to_string(entry.repeats) +
+                             " times)";
+            }
+            inFlight++;
+            conn->async_method_call(
+                [this, done = std::move(entry.done)](
+                    boost::system::error_code ec) {
+                    inFlight--;
+                    if (ec)
+                    {
+                        std::cerr << "Failed to create log entry: "
+                                  << ec.message() << "\n";
+                        failed++;
+                    }
+                    else
+                    {
+                        sent++;
+                        if (done)
+                        {
+                            done();
+                        }
+                    }
+                    send();
+                },
+                "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
+                "xyz.openbmc_project.Logging.Create", "Create", entry.msg,
+                entry.level, std::map<std::string, std::string>{});
+        }
+    }
+
+  public:
+    LogQueue(boost::asio::io_context& io,
+             std::shared_ptr<sdbusplus::asio::connection> conn) :
+        io(io), conn(conn)
+    {
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        statisticsInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/Logging",
+            "xyz.openbmc_project.HostErrorMonitor.LogQueue");
+        statisticsInterface->register_property(
+            "MaxInFlight", maxInFlight,
+            [this](const size_t& requested, size_t& resp) {
+                if (requested == 0)
+                {
+                    std::cerr << "MaxInFlight must be at least 1\n";
+                    return 0;
+                }
+                maxInFlight = requested;
+                resp = requested;
+                send();
+                return 1;
+            });
+        statisticsInterface->register_property("Capacity", capacity);
+        statisticsInterface->register_property_r(
+            "Queued", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) {
+                return static_cast<uint64_t>(queue.size());
+            });
+        statisticsInterface->register_property_r(
+            "HighWater", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return highWater; });
+        statisticsInterface->register_property_r(
+            "Sent", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return sent; });
+        statisticsInterface->register_property_r(
+            "Failed", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return failed; });
+        statisticsInterface->register_property_r(
+            "Dropped", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return dropped; });
+        statisticsInterface->register_property_r(
+            "Coalesced", uint64_t(0), sdbusplus::vtable::property_::none,
+            [this](const uint64_t&) { return coalesced; });
+        publisher.initialize(statisticsInterface);
+    }
+
+    /** @brief Queue a log entry to send once the current handler returns. A
+     *         repeat of the last queued entry is folded into it.
+     *  @param[in] msg - Log message
+     *  @param[in] level - phosphor-logging severity level
+     *  @param[in] done - Called once the entry has been created. Not called
+     *                    if the entry is dropped or cannot be created.
+     */
+    void push(const std::string& msg, const std::string& level,
+              Completion done = nullptr)
+    {
+        if (!queue.empty() && queue.back().msg == msg &&
+            queue.back().level == level)
+        {
+            Entry& last = queue.back();
+            last.repeats++;
+            coalesced++;
+            if (done && last.done)
+            {
+                last.done = [first = std::move(last.done),
+                             second = std::move(done)]() {
+                    first();
+                    second();
+                };
+            }
+            else if (done)
+            {
+                last.done = std::move(done);
+            }
+            return;
+        }
+
+        if (queue.size() >= capacity)
+        {
+            dropped++;
+            if (!overflowing)
+            {
+                overflowing = true;
+                std::cerr << "Log queue full, dropping log entries\n";
+            }
+            return;
+        }
+        overflowing = false;
+        queue.push_back({msg, level, std::move(done), 1});
+        highWater = std::max<uint64_t>(highWater, queue.size());
+
+        if (!sendPosted)
+        {
+            sendPosted = true;
+            boost::asio::post(io, [this]() {
+                sendPosted = false;
+                send();
+            });
+        }
+    }
+};
+
+inline LogQueue& getLogQueue(boost::asio::io_context& io,
+                             std::shared_ptr<sdbusplus::asio::connection> conn)
+{
+    static LogQueue queue(io, conn);
+    return queue;
+}
+
+} // namespace host_error_monitor::log_queue
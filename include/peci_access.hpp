@@ -0,0 +1,276 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#ifdef LIBPECI
+#include <peci.h>
+#endif
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+namespace host_error_monitor::peci_access
+{
+// Completion of a PECI command, in the order of libpeci's EPECIStatus
+enum class Status
+{
+    success,
+    invalidReq,
+    hwErr,
+    driverErr,
+    cpuNotPresent,
+    memErr,
+    timeout,
+};
+
+// Completion codes returned by the CPU
+static constexpr uint8_t ccSuccess = 0x40;
+static constexpr uint8_t ccFatalMCADetected = 0x94;
+
+// CPU model, as the CPUID signature reported by GetCPUID. Only the models
+// the triage supports are named.
+enum class Model : uint32_t
+{
+    skylake = 0x50650,
+    iceLake = 0x606A0,
+};
+
+// PECI client addresses of the CPU sockets
+static constexpr uint8_t minClientAddr = 0x30;
+static constexpr uint8_t maxClientAddr = 0x37;
+
+// The PECI commands used by the triage. All PECI access goes through this
+// interface so the backend can be replaced, for example by the mock in
+// peci_mock.hpp. Calls are made from the PECI worker thread and, during
+// parallel triage, from several threads at once, so backends must be thread
+// safe.
+class PECIAccess
+{
+  public:
+    virtual ~PECIAccess() = default;
+
+    /** @brief Start a sequence of commands from this thread, which a backend
+     *         may use to keep its device open between the commands
+     *  @return False if the sequence could not be started. The commands
+     *          still work, but each one is issued on its own.
+     */
+    virtual bool beginSequence()
+    {
+        return true;
+    }
+
+    virtual void endSequence() {}
+
+    virtual Status getCPUID(uint8_t addr, Model* model, uint8_t* stepping,
+                            uint8_t* cc) = 0;
+
+    virtual Status rdPkgConfig(uint8_t addr, uint8_t index, uint16_t param,
+                               uint8_t readLen, uint8_t* data,
+                               uint8_t* cc) = 0;
+
+    virtual Status rdIAMSR(uint8_t addr, uint8_t threadID, uint16_t msr,
+                           uint64_t* data, uint8_t* cc) = 0;
+
+    virtual Status rdPCIConfigLocal(uint8_t addr, uint8_t bus, uint8_t device,
+                                    uint8_t function, uint16_t reg,
+                                    uint8_t readLen, uint8_t* data,
+                                    uint8_t* cc) = 0;
+
+    virtual Status rdEndPointConfigPciLocal(
+        uint8_t addr, uint8_t segment, uint8_t bus, uint8_t device,
+        uint8_t function, uint16_t reg, uint8_t readLen, uint8_t* data,
+        uint8_t* cc) = 0;
+};
+
+#ifdef LIBPECI
+static_assert(minClientAddr == MIN_CLIENT_ADDR &&
+              maxClientAddr == MAX_CLIENT_ADDR);
+static_assert(ccSuccess == PECI_DEV_CC_SUCCESS &&
+              ccFatalMCADetected == PECI_DEV_CC_FATAL_MCA_DETECTED);
+
+// Default backend using libpeci. Outside of a sequence, libpeci opens and
+// closes the PECI device node for every command. Inside a sequence the node
+// is opened once for the thread and the commands are issued on it.
+class LibPECIAccess : public PECIAccess
+{
+    // PECI device held open by this thread's sequence
+    static inline thread_local int sequenceFd = -1;
+    static inline thread_local size_t sequenceDepth = 0;
+
+    static Status toStatus(EPECIStatus peciStatus)
+    {
+        switch (peciStatus)
+        {
+            case PECI_CC_SUCCESS:
+                return Status::success;
+            case PECI_CC_INVALID_REQ:
+                return Status::invalidReq;
+            case PECI_CC_HW_ERR:
+                return Status::hwErr;
+            case PECI_CC_CPU_NOT_PRESENT:
+                return Status::cpuNotPresent;
+            case PECI_CC_MEM_ERR:
+                return Status::memErr;
+            case PECI_CC_TIMEOUT:
+                return Status::timeout;
+            default:
+                return Status::driverErr;
+        }
+    }
+
+  public:
+    bool beginSequence() override
+    {
+        if (sequenceDepth++ > 0)
+        {
+            return sequenceFd >= 0;
+        }
+        int fd = -1;
+        EPECIStatus peciStatus = peci_Lock(&fd, PECI_WAIT_FOREVER);
+        if (peciStatus != PECI_CC_SUCCESS)
+        {
+            std::cerr << "Failed to open the PECI device: " << peciStatus
+                      << "\n";
+            return false;
+        }
+        sequenceFd = fd;
+        return true;
+    }
+
+    void endSequence() override
+    {
+        if (sequenceDepth == 0 || --sequenceDepth > 0)
+        {
+            return;
+        }
+        if (sequenceFd >= 0)
+        {
+            peci_Unlock(sequenceFd);
+            sequenceFd = -1;
+        }
+    }
+
+    Status getCPUID(uint8_t addr, Model* model, uint8_t* stepping,
+                    uint8_t* cc) override
+    {
+        CPUModel cpuModel{};
+        Status status =
+            toStatus(peci_GetCPUID(addr, &cpuModel, stepping, cc));
+        *model = static_cast<Model>(cpuModel);
+        return status;
+    }
+
+    Status rdPkgConfig(uint8_t addr, uint8_t index, uint16_t param,
+                       uint8_t readLen, uint8_t* data, uint8_t* cc) override
+    {
+        if (sequenceFd >= 0)
+        {
+            return toStatus(peci_RdPkgConfig_seq(addr, index, param, readLen,
+                                                 data, sequenceFd, cc));
+        }
+        return toStatus(
+            peci_RdPkgConfig(addr, index, param, readLen, data, cc));
+    }
+
+    Status rdIAMSR(uint8_t addr, uint8_t threadID, uint16_t msr,
+                   uint64_t* data, uint8_t* cc) override
+    {
+        // libpeci has no sequence form of RdIAMSR
+        return toStatus(peci_RdIAMSR(addr, threadID, msr, data, cc));
+    }
+
+    Status rdPCIConfigLocal(uint8_t addr, uint8_t bus, uint8_t device,
+                            uint8_t function, uint16_t reg, uint8_t readLen,
+                            uint8_t* data, uint8_t* cc) override
+    {
+        if (sequenceFd >= 0)
+        {
+            return toStatus(peci_RdPCIConfigLocal_seq(addr, bus, device,
+                                                      function, reg, readLen,
+                                                      data, sequenceFd, cc));
+        }
+        return toStatus(peci_RdPCIConfigLocal(addr, bus, device, function,
+                                              reg, readLen, data, cc));
+    }
+
+    Status rdEndPointConfigPciLocal(uint8_t addr, uint8_t segment,
+                                    uint8_t bus, uint8_t device,
+                                    uint8_t function, uint16_t reg,
+                                    uint8_t readLen, uint8_t* data,
+                                    uint8_t* cc) override
+    {
+        if (sequenceFd >= 0)
+        {
+            return toStatus(peci_RdEndPointConfigPciLocal_seq(
+                addr, segment, bus, device, function, reg, readLen, data,
+                sequenceFd, cc));
+        }
+        return toStatus(peci_RdEndPointConfigPciLocal(addr, segment, bus,
+                                                      device, function, reg,
+                                                      readLen, data, cc));
+    }
+};
+#endif
+
+// Issues the commands made by this thread during its lifetime as one
+// sequence
+class Sequence
+{
+    PECIAccess& access;
+
+  public:
+    explicit Sequence(PECIAccess& access) : access(access)
+    {
+        access.beginSequence();
+    }
+
+    Sequence(const Sequence&) = delete;
+    Sequence& operator=(const Sequence&) = delete;
+
+    ~Sequence()
+    {
+        access.endSequence();
+    }
+};
+
+// Without libpeci there is no default backend, and one must be set with
+// setPECIAccess() before any PECI work is submitted
+inline std::unique_ptr<PECIAccess>& accessInstance()
+{
+#ifdef LIBPECI
+    static std::unique_ptr<PECIAccess> access =
+        std::make_unique<LibPECIAccess>();
+#else
+    static std::unique_ptr<PECIAccess> access;
+#endif
+    return access;
+}
+
+inline PECIAccess& getPECIAccess()
+{
+    return *accessInstance();
+}
+
+/** @brief Replace the PECI backend. Only call this before any PECI work is
+ *         submitted.
+ *  @param[in] access - New backend
+ */
+inline void setPECIAccess(std::unique_ptr<PECIAccess> access)
+{
+    accessInstance() = std::move(access);
+}
+
+} // namespace host_error_monitor::peci_access
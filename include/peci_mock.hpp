@@ -0,0 +1,275 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <cpu_registers.hpp>
+#include <peci_access.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+
+namespace host_error_monitor::peci_mock
+{
+// In-process PECI backend that simulates the CPU sockets, so the triage can
+// run without hardware. Each socket has a CPUID and register contents, and
+// any command can be given a latency and a failing completion. A PECI
+// timeout is simulated by a response with Status::timeout and a latency of
+// the timeout.
+class MockPECIAccess : public host_error_monitor::peci_access::PECIAccess
+{
+  public:
+    using Status = host_error_monitor::peci_access::Status;
+    using Model = host_error_monitor::peci_access::Model;
+
+    struct Response
+    {
+        Status status = Status::success;
+        uint8_t cc = host_error_monitor::peci_access::ccSuccess;
+        std::chrono::microseconds latency{0};
+    };
+
+  private:
+    using Space = host_error_monitor::cpu_registers::Space;
+    using Register = host_error_monitor::cpu_registers::Register;
+    using Role = host_error_monitor::cpu_registers::Role;
+
+    // Space, segment, bus, device, function, offset, param
+    using Location =
+        std::tuple<Space, uint8_t, uint8_t, uint8_t, uint8_t, uint16_t,
+                   uint16_t>;
+
+    struct Socket
+    {
+        Model model;
+        uint8_t stepping;
+        std::map<Location, uint64_t> registers;
+        std::map<Location, Response> responses;
+        std::optional<Response> cpuidResponse;
+    };
+
+    mutable std::mutex mutex;
+    std::map<uint8_t, Socket> sockets;
+    std::chrono::microseconds latency{0};
+    size_t commands = 0;
+
+    static Location location(const Register& reg)
+    {
+        return {reg.space,    reg.segment, reg.bus,  reg.device,
+                reg.function, reg.offset,  reg.param};
+    }
+
+    Status command(uint8_t addr, const Location& loc, uint64_t& value,
+                   uint8_t* cc)
+    {
+        Response response;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands++;
+            auto socket = sockets.find(addr);
+            if (socket == sockets.end())
+            {
+                *cc = 0;
+                return Status::cpuNotPresent;
+            }
+            response.latency = latency;
+            auto override = socket->second.responses.find(loc);
+            if (override != socket->second.responses.end())
+            {
+                response = override->second;
+            }
+            auto reg = socket->second.registers.find(loc);
+            value = reg == socket->second.registers.end() ? 0 : reg->second;
+        }
+        if (response.latency.count() > 0)
+        {
+            std::this_thread::sleep_for(response.latency);
+        }
+        *cc = response.cc;
+        return response.status;
+    }
+
+    Status readBytes(uint8_t addr, const Location& loc, uint8_t readLen,
+                     uint8_t* data, uint8_t* cc)
+    {
+        uint64_t value = 0;
+        Status status = command(addr, loc, value, cc);
+        std::memcpy(data, &value, std::min<size_t>(readLen, sizeof(value)));
+        return status;
+    }
+
+    template <typename Apply>
+    void forRole(uint8_t addr, Role role, Apply apply)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto socket = sockets.find(addr);
+        if (socket == sockets.end())
+        {
+            return;
+        }
+        const host_error_monitor::cpu_registers::ModelRegisters* model =
+            host_error_monitor::cpu_registers::findModel(
+                socket->second.model);
+        if (model == nullptr)
+        {
+            return;
+        }
+        for (const Register& reg : model->registers)
+        {
+            if (reg.role == role)
+            {
+                apply(socket->second, location(reg));
+            }
+        }
+    }
+
+  public:
+    /** @brief Add a present CPU. Its registers all read as zero.
+     *  @param[in] addr - PECI address of the CPU
+     *  @param[in] model - CPU model returned by GetCPUID
+     *  @param[in] stepping - CPU stepping returned by GetCPUID
+     */
+    void addSocket(uint8_t addr, Model model, uint8_t stepping = 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sockets[addr] = Socket{model, stepping, {}, {}, std::nullopt};
+    }
+
+    void removeSocket(uint8_t addr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sockets.erase(addr);
+    }
+
+    /** @brief Set the value of every register of a CPU with a role
+     *  @param[in] addr - PECI address of the CPU
+     *  @param[in] role - Register role in the CPU model's register table
+     *  @param[in] value - Register value
+     */
+    void setRegister(uint8_t addr, Role role, uint64_t value)
+    {
+        forRole(addr, role, [value](Socket& socket, const Location& loc) {
+            socket.registers[loc] = value;
+        });
+    }
+
+    /** @brief Set how every register of a CPU with a role responds
+     *  @param[in] addr - PECI address of the CPU
+     *  @param[in] role - Register role in the CPU model's register table
+     *  @param[in] response - Completion and latency of reads
+     */
+    void setResponse(uint8_t addr, Role role, const Response& response)
+    {
+        forRole(addr, role, [&response](Socket& socket, const Location& loc) {
+            socket.responses[loc] = response;
+        });
+    }
+
+    void setCPUIDResponse(uint8_t addr, const Response& response)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto socket = sockets.find(addr);
+        if (socket != sockets.end())
+        {
+            socket->second.cpuidResponse = response;
+        }
+    }
+
+    /** @brief Set the latency of every command without its own response
+     *  @param[in] newLatency - Time each command takes
+     */
+    void setLatency(std::chrono::microseconds newLatency)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        latency = newLatency;
+    }
+
+    size_t commandCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return commands;
+    }
+
+    Status getCPUID(uint8_t addr, Model* model, uint8_t* stepping,
+                    uint8_t* cc) override
+    {
+        Response response;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands++;
+            auto socket = sockets.find(addr);
+            if (socket == sockets.end())
+            {
+                *cc = 0;
+                return Status::cpuNotPresent;
+            }
+            *model = socket->second.model;
+            *stepping = socket->second.stepping;
+            response.latency = latency;
+            if (socket->second.cpuidResponse)
+            {
+                response = *socket->second.cpuidResponse;
+            }
+        }
+        if (response.latency.count() > 0)
+        {
+            std::this_thread::sleep_for(response.latency);
+        }
+        *cc = response.cc;
+        return response.status;
+    }
+
+    Status rdPkgConfig(uint8_t addr, uint8_t index, uint16_t param,
+                       uint8_t readLen, uint8_t* data, uint8_t* cc) override
+    {
+        return readBytes(addr, {Space::pkgConfig, 0, 0, 0, 0, index, param},
+                         readLen, data, cc);
+    }
+
+    Status rdIAMSR(uint8_t addr, uint8_t, uint16_t msr, uint64_t* data,
+                   uint8_t* cc) override
+    {
+        return command(addr, {Space::iaMSR, 0, 0, 0, 0, msr, 0}, *data, cc);
+    }
+
+    Status rdPCIConfigLocal(uint8_t addr, uint8_t bus, uint8_t device,
+                            uint8_t function, uint16_t reg, uint8_t readLen,
+                            uint8_t* data, uint8_t* cc) override
+    {
+        return readBytes(
+            addr, {Space::pciConfigLocal, 0, bus, device, function, reg, 0},
+            readLen, data, cc);
+    }
+
+    Status rdEndPointConfigPciLocal(uint8_t addr, uint8_t segment,
+                                    uint8_t bus, uint8_t device,
+                                    uint8_t function, uint16_t reg,
+                                    uint8_t readLen, uint8_t* data,
+                                    uint8_t* cc) override
+    {
+        return readBytes(addr,
+                         {Space::endPointPciLocal, segment, bus, device,
+                          function, reg, 0},
+                         readLen, data, cc);
+    }
+};
+
+} // namespace host_error_monitor::peci_mock
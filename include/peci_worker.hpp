@@ -0,0 +1,283 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <dbus_objects.hpp>
+#include <latency_histogram.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace host_error_monitor::peci_worker
+{
+static constexpr bool debug = false;
+
+// Priority of PECI work. Queued work runs highest priority first, so error
+// triage is never stuck behind less urgent PECI reads.
+enum class Priority
+{
+    normal,
+    errPin,
+    ierr,
+};
+
+static constexpr std::array<const char*, 3> priorityNames = {
+    "Normal", "ErrPin", "IERR"};
+
+// Runs blocking PECI work on a dedicated thread so GPIO edges, timers and
+// D-Bus requests keep being handled while the CPUs are triaged.
+//
+// The io_context is built with BOOST_ASIO_DISABLE_THREADS, so the worker
+// never touches it. Completions are queued under a mutex and the io_context
+// is woken through an eventfd to run them.
+class PECIWorker
+{
+    using Task = std::function<void()>;
+    using LatencyHistogram =
+        host_error_monitor::latency_histogram::LatencyHistogram;
+
+    struct Job
+    {
+        Task task;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    boost::asio::posix::stream_descriptor wakeup;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    // Queued jobs of each priority
+    std::array<std::deque<Job>, priorityNames.size()> jobs;
+    std::deque<Task> completions;
+    bool stopping = false;
+
+    // Time each job waited for the worker, by priority
+    std::array<LatencyHistogram, priorityNames.size()> waits;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> statisticsInterface;
+
+    // Take the oldest job of the highest priority. Called with the mutex
+    // held.
+    std::optional<Job> takeJob()
+    {
+        for (size_t priority = jobs.size(); priority-- > 0;)
+        {
+            if (jobs[priority].empty())
+            {
+                continue;
+            }
+            Job job = std::move(jobs[priority].front());
+            jobs[priority].pop_front();
+            waits[priority].record(std::chrono::steady_clock::now() -
+                                   job.queued);
+            return job;
+        }
+        return std::nullopt;
+    }
+
+    void runJobs()
+    {
+        while (true)
+        {
+            std::optional<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this, &job]() {
+                    if (stopping)
+                    {
+                        return true;
+                    }
+                    job = takeJob();
+                    return job.has_value();
+                });
+                if (stopping)
+                {
+                    return;
+                }
+            }
+            job->task();
+        }
+    }
+
+    void complete(Task completion)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            completions.push_back(std::move(completion));
+        }
+        uint64_t count = 1;
+        if (::write(wakeup.native_handle(), &count, sizeof(count)) < 0)
+        {
+            std::cerr << "Failed to wake the PECI completion handler: "
+                      << std::strerror(errno) << "\n";
+        }
+    }
+
+    void waitForCompletions()
+    {
+        wakeup.async_wait(
+            boost::asio::posix::stream_descriptor::wait_read,
+            [this](const boost::system::error_code ec) {
+                if (ec)
+                {
+                    // operation_aborted is expected if wait is canceled.
+                    if (ec != boost::asio::error::operation_aborted)
+                    {
+                        std::cerr << "PECI completion wait error: "
+                                  << ec.message() << "\n";
+                    }
+                    return;
+                }
+
+                uint64_t count = 0;
+                if (::read(wakeup.native_handle(), &count, sizeof(count)) < 0)
+                {
+                    std::cerr << "Failed to read the PECI completion count: "
+                              << std::strerror(errno) << "\n";
+                }
+
+                std::deque<Task> ready;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready.swap(completions);
+                }
+                if constexpr (debug)
+                {
+                    std::cerr << "Running " << ready.size()
+                              << " PECI completions\n";
+                }
+                for (Task& completion : ready)
+                {
+                    completion();
+                }
+                waitForCompletions();
+            });
+    }
+
+  public:
+    explicit PECIWorker(boost::asio::io_context& io) :
+        wakeup(io, eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+    {
+        waitForCompletions();
+        thread = std::thread([this]() { runJobs(); });
+    }
+
+    PECIWorker(const PECIWorker&) = delete;
+    PECIWorker& operator=(const PECIWorker&) = delete;
+
+    ~PECIWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_one();
+        thread.join();
+    }
+
+    /** @brief Run blocking PECI work on the worker thread
+     *  @param[in] work - Called on the worker thread. It must not use the
+     *                    io_context, D-Bus or any monitor state.
+     *  @param[in] done - Called on the io_context with the result of work
+     *  @param[in] priority - Queued work of a higher priority runs first
+     */
+    template <typename Work, typename Done>
+    void submit(Work work, Done done, Priority priority = Priority::normal)
+    {
+        using Result = std::invoke_result_t<Work&>;
+        Task job = [this, work = std::move(work),
+                    done = std::move(done)]() mutable {
+            Result result = work();
+            complete([done = std::move(done),
+                      result = std::move(result)]() mutable {
+                done(std::move(result));
+            });
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs[static_cast<size_t>(priority)].push_back(
+                {std::move(job), std::chrono::steady_clock::now()});
+        }
+        jobReady.notify_one();
+    }
+
+    /** @brief Publish how long the work of each priority waited to run
+     *  @param[in] conn - D-Bus connection
+     */
+    void registerStatistics(std::shared_ptr<sdbusplus::asio::connection> conn)
+    {
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        statisticsInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/statistics/PECI",
+            "xyz.openbmc_project.HostErrorMonitor.PECIWorker");
+        statisticsInterface->register_property(
+            "LatencyBucketBoundsUs", LatencyHistogram::getBucketBoundsUs());
+        for (size_t priority = 0; priority < priorityNames.size(); priority++)
+        {
+            std::string name = priorityNames[priority];
+            statisticsInterface->register_property_r(
+                name + "WaitCounts", std::vector<uint64_t>{},
+                sdbusplus::vtable::property_::none,
+                [this, priority](const std::vector<uint64_t>&) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return waits[priority].getCounts();
+                });
+            statisticsInterface->register_property_r(
+                name + "WaitMaxUs", uint64_t(0),
+                sdbusplus::vtable::property_::none,
+                [this, priority](const uint64_t&) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return waits[priority].getMaxUs();
+                });
+            statisticsInterface->register_property_r(
+                name + "Queued", uint64_t(0),
+                sdbusplus::vtable::property_::none,
+                [this, priority](const uint64_t&) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return static_cast<uint64_t>(jobs[priority].size());
+                });
+        }
+        publisher.initialize(statisticsInterface);
+    }
+};
+
+inline PECIWorker& getPECIWorker(boost::asio::io_context& io)
+{
+    static PECIWorker worker(io);
+    return worker;
+}
+
+} // namespace host_error_monitor::peci_worker
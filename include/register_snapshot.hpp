@@ -0,0 +1,252 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <dbus_objects.hpp>
+#include <host_error_monitor.hpp>
+#include <peci_access.hpp>
+#include <peci_worker.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace host_error_monitor::register_snapshot
+{
+static constexpr bool debug = false;
+
+enum class Stage
+{
+    // The error pin was first seen asserted
+    atAssert,
+    // The error pin stayed asserted until its timeout
+    atTimeout,
+};
+
+// CPU, register name and value
+using RegisterValue = std::tuple<uint32_t, std::string, uint64_t>;
+// CPU, register name, value at assert and value at timeout
+using RegisterDelta = std::tuple<uint32_t, std::string, uint64_t, uint64_t>;
+
+#ifdef LIBPECI
+struct CPUSnapshot
+{
+    size_t cpu;
+    host_error_monitor::cpu_registers::SnapshotValues values;
+};
+
+struct Capture
+{
+    Stage stage;
+    // Wall clock time the capture was requested
+    uint64_t timeUs;
+    std::vector<CPUSnapshot> cpus;
+};
+
+// Blocking snapshot of every CPU. Runs on the PECI worker thread.
+static std::vector<CPUSnapshot> readSnapshots()
+{
+    std::vector<CPUSnapshot> snapshots;
+    std::vector<CPUInfo> cpus = getCPUIDCache().getCPUs();
+    host_error_monitor::peci_access::Sequence sequence(
+        host_error_monitor::peci_access::getPECIAccess());
+    for (const CPUInfo& cpuInfo : cpus)
+    {
+        snapshots.push_back(
+            {cpuInfo.cpu, host_error_monitor::cpu_registers::readSnapshot(
+                              cpuInfo.addr, cpuInfo.model)});
+    }
+    return snapshots;
+}
+#endif
+
+// Keeps the last few register snapshots of an error pin in memory and
+// publishes the values at assert and what changed by the timeout
+class RegisterSnapshots
+{
+#ifdef LIBPECI
+    static const constexpr size_t ringSize = 16;
+
+    boost::asio::io_context& io;
+    host_error_monitor::peci_worker::Priority priority;
+    std::shared_ptr<sdbusplus::asio::dbus_interface> snapshotInterface;
+
+    std::array<Capture, ringSize> ring;
+    // Position of the next capture and the number of captures held
+    size_t next = 0;
+    size_t count = 0;
+
+    // Get the most recent capture of a stage
+    const Capture* findLatest(Stage stage) const
+    {
+        for (size_t i = 1; i <= count; i++)
+        {
+            const Capture& capture = ring[(next + ringSize - i) % ringSize];
+            if (capture.stage == stage)
+            {
+                return &capture;
+            }
+        }
+        return nullptr;
+    }
+
+    static std::vector<RegisterValue> values(const Capture& capture)
+    {
+        std::vector<RegisterValue> result;
+        for (const CPUSnapshot& snapshot : capture.cpus)
+        {
+            for (size_t i = 0; i < snapshot.values.size(); i++)
+            {
+                if (snapshot.values[i])
+                {
+                    result.emplace_back(
+                        snapshot.cpu,
+                        host_error_monitor::cpu_registers::snapshotNames[i],
+                        *snapshot.values[i]);
+                }
+            }
+        }
+        return result;
+    }
+
+    // Registers that changed between two captures. Registers that could not
+    // be read in either capture are left out.
+    static std::vector<RegisterDelta> delta(const Capture& before,
+                                            const Capture& after)
+    {
+        std::vector<RegisterDelta> result;
+        for (const CPUSnapshot& snapshot : after.cpus)
+        {
+            for (const CPUSnapshot& old : before.cpus)
+            {
+                if (old.cpu != snapshot.cpu)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < snapshot.values.size(); i++)
+                {
+                    if (old.values[i] && snapshot.values[i] &&
+                        *old.values[i] != *snapshot.values[i])
+                    {
+                        result.emplace_back(
+                            snapshot.cpu,
+                            host_error_monitor::cpu_registers::snapshotNames
+                                [i],
+                            *old.values[i], *snapshot.values[i]);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    void record(Capture capture)
+    {
+        ring[next] = std::move(capture);
+        const Capture& latest = ring[next];
+        next = (next + 1) % ringSize;
+        count = std::min(count + 1, ringSize);
+
+        if constexpr (debug)
+        {
+            std::cerr << "Captured registers of " << latest.cpus.size()
+                      << " CPUs\n";
+        }
+
+        if (latest.stage == Stage::atAssert)
+        {
+            snapshotInterface->set_property("AssertTimeUs", latest.timeUs);
+            snapshotInterface->set_property("AssertValues", values(latest));
+            snapshotInterface->set_property("TimeoutTimeUs", uint64_t(0));
+            snapshotInterface->set_property("Delta",
+                                            std::vector<RegisterDelta>{});
+            return;
+        }
+
+        snapshotInterface->set_property("TimeoutTimeUs", latest.timeUs);
+        const Capture* assertCapture = findLatest(Stage::atAssert);
+        if (assertCapture != nullptr)
+        {
+            snapshotInterface->set_property("Delta",
+                                            delta(*assertCapture, latest));
+        }
+    }
+#endif
+
+  public:
+    RegisterSnapshots(
+        [[maybe_unused]] boost::asio::io_context& io,
+        [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn,
+        [[maybe_unused]] const std::string& signalName,
+        [[maybe_unused]] host_error_monitor::peci_worker::Priority priority)
+#ifdef LIBPECI
+        : io(io), priority(priority)
+#endif
+    {
+#ifdef LIBPECI
+        std::vector<std::string> registerNames(
+            host_error_monitor::cpu_registers::snapshotNames.begin(),
+            host_error_monitor::cpu_registers::snapshotNames.end());
+
+        host_error_monitor::dbus_objects::ObjectPublisher& publisher =
+            host_error_monitor::dbus_objects::getObjectPublisher(conn);
+        snapshotInterface = publisher.addInterface(
+            "/xyz/openbmc_project/host_error_monitor/snapshot/" + signalName,
+            "xyz.openbmc_project.HostErrorMonitor.RegisterSnapshot");
+        snapshotInterface->register_property("RegisterNames", registerNames);
+        snapshotInterface->register_property("AssertTimeUs", uint64_t(0));
+        snapshotInterface->register_property("AssertValues",
+                                             std::vector<RegisterValue>{});
+        snapshotInterface->register_property("TimeoutTimeUs", uint64_t(0));
+        snapshotInterface->register_property("Delta",
+                                             std::vector<RegisterDelta>{});
+        publisher.initialize(snapshotInterface);
+#endif
+    }
+
+    /** @brief Snapshot the registers of every CPU without blocking
+     *  @param[in] stage - Stage of the error pin being captured
+     */
+    void capture([[maybe_unused]] Stage stage)
+    {
+#ifdef LIBPECI
+        // The CPUs cannot answer while the host is off
+        if (hostIsOff())
+        {
+            return;
+        }
+        uint64_t timeUs =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        host_error_monitor::peci_worker::getPECIWorker(io).submit(
+            []() { return readSnapshots(); },
+            [this, stage, timeUs](std::vector<CPUSnapshot> cpus) {
+                record({stage, timeUs, std::move(cpus)});
+            },
+            priority);
+#endif
+    }
+};
+
+} // namespace host_error_monitor::register_snapshot
@@ -0,0 +1,288 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <boost/container/flat_map.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/bus/match.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace host_error_monitor::settings_cache
+{
+static constexpr bool debug = false;
+
+using SettingValue =
+    std::variant<bool, uint8_t, int16_t, uint16_t, int32_t, uint32_t, int64_t,
+                 uint64_t, double, std::string>;
+using SettingsMap = boost::container::flat_map<std::string, SettingValue>;
+
+static const constexpr char* settingsService = "xyz.openbmc_project.Settings";
+
+// Local copy of one settings object. It is loaded with GetAll and kept
+// current from PropertiesChanged signals, and loaded again whenever the
+// settings service restarts, so error handlers read their settings without
+// a D-Bus round trip.
+class SettingsObject
+{
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    std::string path;
+    std::string interface;
+    SettingsMap properties;
+    bool loaded = false;
+
+    using ChangeHandler =
+        std::function<void(const std::string& name, const SettingValue&)>;
+    std::vector<ChangeHandler> changeHandlers;
+
+    std::unique_ptr<sdbusplus::bus::match_t> propertiesChangedMatch;
+    std::unique_ptr<sdbusplus::bus::match_t> nameOwnerChangedMatch;
+
+    void load()
+    {
+        conn->async_method_call(
+            [this](boost::system::error_code ec, const SettingsMap& all) {
+                if (ec)
+                {
+                    std::cerr << "Failed to load " << path
+                              << " settings: " << ec.message() << "\n";
+                    return;
+                }
+                SettingsMap previous = std::move(properties);
+                bool reload = loaded;
+                properties = all;
+                loaded = true;
+                if constexpr (debug)
+                {
+                    std::cerr << "Loaded " << properties.size()
+                              << " settings from " << path << "\n";
+                }
+                if (!reload)
+                {
+                    return;
+                }
+                // Settings changed while the service was away are reported
+                // like any other change
+                for (const auto& [name, value] : all)
+                {
+                    auto old = previous.find(name);
+                    if (old == previous.end() || old->second != value)
+                    {
+                        notify(name, value);
+                    }
+                }
+            },
+            settingsService, path, "org.freedesktop.DBus.Properties",
+            "GetAll", interface);
+    }
+
+    void update(sdbusplus::message_t& msg)
+    {
+        std::string interfaceName;
+        SettingsMap changed;
+        try
+        {
+            msg.read(interfaceName, changed);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Unable to read " << path << " settings change\n";
+            return;
+        }
+        for (const auto& [name, value] : changed)
+        {
+            properties[name] = value;
+            notify(name, value);
+        }
+    }
+
+    void notify(const std::string& name, const SettingValue& value)
+    {
+        for (const ChangeHandler& handler : changeHandlers)
+        {
+            handler(name, value);
+        }
+    }
+
+  public:
+    SettingsObject(std::shared_ptr<sdbusplus::asio::connection> conn,
+                   const std::string& path, const std::string& interface) :
+        conn(conn), path(path), interface(interface)
+    {
+        propertiesChangedMatch = std::make_unique<sdbusplus::bus::match_t>(
+            *conn,
+            sdbusplus::bus::match::rules::propertiesChanged(path, interface),
+            [this](sdbusplus::message_t& msg) { update(msg); });
+        nameOwnerChangedMatch = std::make_unique<sdbusplus::bus::match_t>(
+            *conn,
+            sdbusplus::bus::match::rules::nameOwnerChanged(settingsService),
+            [this](sdbusplus::message_t& msg) {
+                std::string name;
+                std::string oldOwner;
+                std::string newOwner;
+                try
+                {
+                    msg.read(name, oldOwner, newOwner);
+                }
+                catch (std::exception& e)
+                {
+                    std::cerr << "Unable to read settings owner change\n";
+                    return;
+                }
+                if (!newOwner.empty())
+                {
+                    load();
+                }
+            });
+        load();
+    }
+
+    SettingsObject(const SettingsObject&) = delete;
+    SettingsObject& operator=(const SettingsObject&) = delete;
+
+    /** @brief Get a setting. It is read from the settings service only if
+     *         the cache has not loaded yet.
+     *  @param[in] name - Property name
+     *  @param[in] done - Called with the value, or unset if it is not
+     *                    available. Called before returning if cached.
+     */
+    template <typename T>
+    void get(const std::string& name,
+             const std::function<void(std::optional<T>)>& done)
+    {
+        if (loaded)
+        {
+            auto it = properties.find(name);
+            if (it == properties.end())
+            {
+                return done(std::nullopt);
+            }
+            const T* value = std::get_if<T>(&it->second);
+            if (value == nullptr)
+            {
+                std::cerr << name << " setting invalid\n";
+                return done(std::nullopt);
+            }
+            return done(*value);
+        }
+
+        conn->async_method_call(
+            [name, done](boost::system::error_code ec,
+                         const SettingValue& property) {
+                if (ec)
+                {
+                    return done(std::nullopt);
+                }
+                const T* value = std::get_if<T>(&property);
+                if (value == nullptr)
+                {
+                    std::cerr << name << " setting invalid\n";
+                    return done(std::nullopt);
+                }
+                done(*value);
+            },
+            settingsService, path, "org.freedesktop.DBus.Properties", "Get",
+            interface, name);
+    }
+
+    /** @brief Set a setting. The cache is updated at once, ahead of the
+     *         PropertiesChanged signal, and restored if the Set fails.
+     *  @param[in] name - Property name
+     *  @param[in] value - New value
+     *  @param[in] done - Called with the result of the Set call
+     */
+    template <typename T>
+    void set(const std::string& name, const T& value,
+             const std::function<void(boost::system::error_code)>& done =
+                 nullptr)
+    {
+        std::optional<SettingValue> previous;
+        if (loaded)
+        {
+            auto it = properties.find(name);
+            if (it != properties.end())
+            {
+                previous = it->second;
+            }
+            properties[name] = value;
+        }
+        conn->async_method_call(
+            [this, name, value, previous,
+             done](boost::system::error_code ec) {
+                if (ec)
+                {
+                    std::cerr << "Failed to set " << name << ": "
+                              << ec.message() << "\n";
+                    // Restore the cache unless the setting has changed
+                    // again since
+                    auto it = properties.find(name);
+                    if (it != properties.end() &&
+                        it->second == SettingValue(value))
+                    {
+                        if (previous)
+                        {
+                            it->second = *previous;
+                        }
+                        else
+                        {
+                            properties.erase(it);
+                        }
+                    }
+                }
+                if (done)
+                {
+                    done(ec);
+                }
+            },
+            settingsService, path, "org.freedesktop.DBus.Properties", "Set",
+            interface, name, std::variant<T>{value});
+    }
+
+    /** @brief Add a handler to call when the settings service reports a
+     *         changed setting
+     *  @param[in] handler - Called with the name and new value
+     */
+    void addChangeHandler(ChangeHandler handler)
+    {
+        changeHandlers.push_back(std::move(handler));
+    }
+};
+
+inline SettingsObject& getProcessorErrorConfig(
+    std::shared_ptr<sdbusplus::asio::connection> conn)
+{
+    static SettingsObject settings(
+        conn, "/xyz/openbmc_project/control/processor_error_config",
+        "xyz.openbmc_project.Control.Processor.ErrConfig");
+    return settings;
+}
+
+inline SettingsObject& getResetDisables(
+    std::shared_ptr<sdbusplus::asio::connection> conn)
+{
+    static SettingsObject settings(
+        conn, "/xyz/openbmc_project/control/bmc_reset_disables",
+        "xyz.openbmc_project.Control.ResetDisables");
+    return settings;
+}
+
+} // namespace host_error_monitor::settings_cache
@@ -0,0 +1,383 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+
+namespace host_error_monitor::timer_wheel
+{
+static constexpr bool debug = false;
+
+// Two-level hierarchical timer wheel driven by a single asio timer.
+// Deadlines are rounded up to a common tick, so timers that expire in the
+// same tick run from the same wakeup. The asio timer is only armed for the
+// next tick that has work, so an idle wheel never wakes up.
+class TimerWheel
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr Clock::duration tick = std::chrono::milliseconds(10);
+
+    // A timer slot owned by a monitor. Like a steady_timer, scheduling a
+    // pending timer replaces its deadline and handler.
+    class Timer
+    {
+        friend class TimerWheel;
+
+        TimerWheel& wheel;
+        Timer* prev = nullptr;
+        Timer* next = nullptr;
+        Timer** slot = nullptr;
+        uint64_t expiryTick = 0;
+        std::function<void()> handler;
+
+      public:
+        explicit Timer(TimerWheel& wheel) : wheel(wheel) {}
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        ~Timer()
+        {
+            cancel();
+        }
+
+        /** @brief Run a handler at a deadline
+         *  @param[in] deadline - Time to run the handler. It runs on the
+         *                        first wheel tick at or after this time.
+         *  @param[in] newHandler - Handler to run
+         */
+        void schedule(Clock::time_point deadline,
+                      std::function<void()> newHandler)
+        {
+            cancel();
+            handler = std::move(newHandler);
+            wheel.insert(*this, wheel.toTick(deadline));
+        }
+
+        void cancel()
+        {
+            if (slot != nullptr)
+            {
+                wheel.remove(*this);
+            }
+            handler = nullptr;
+        }
+
+        bool pending() const
+        {
+            return slot != nullptr;
+        }
+    };
+
+  private:
+    static const constexpr uint64_t level0Slots = 256;
+    static const constexpr uint64_t level1Slots = 64;
+
+    boost::asio::steady_timer timer;
+    Clock::time_point origin;
+    // Last tick processed
+    uint64_t currentTick = 0;
+    std::optional<uint64_t> armedTick;
+    bool advancing = false;
+    size_t level0Count = 0;
+    size_t level1Count = 0;
+    std::array<Timer*, level0Slots> level0{};
+    std::array<Timer*, level1Slots> level1{};
+
+    Clock::time_point toTime(uint64_t tickNum) const
+    {
+        return origin + tickNum * tick;
+    }
+
+    uint64_t toTick(Clock::time_point deadline) const
+    {
+        if (deadline <= origin)
+        {
+            return currentTick + 1;
+        }
+        // Round up so a timer never runs before its deadline
+        uint64_t tickNum =
+            (deadline - origin + tick - Clock::duration(1)) / tick;
+        return std::max(tickNum, currentTick + 1);
+    }
+
+    uint64_t nowTick() const
+    {
+        return (Clock::now() - origin) / tick;
+    }
+
+    void link(Timer& t, Timer** slot)
+    {
+        t.slot = slot;
+        t.prev = nullptr;
+        t.next = *slot;
+        if (t.next != nullptr)
+        {
+            t.next->prev = &t;
+        }
+        *slot = &t;
+    }
+
+    void place(Timer& t)
+    {
+        uint64_t delta = t.expiryTick - currentTick;
+        if (delta < level0Slots)
+        {
+            link(t, &level0[t.expiryTick % level0Slots]);
+            level0Count++;
+            return;
+        }
+        // Timers past the level 1 range wait in its farthest slot and are
+        // placed again when that slot cascades
+        uint64_t level1Tick = std::min(
+            t.expiryTick, currentTick + (level1Slots - 1) * level0Slots);
+        link(t, &level1[(level1Tick / level0Slots) % level1Slots]);
+        level1Count++;
+    }
+
+    void insert(Timer& t, uint64_t expiryTick)
+    {
+        if (level0Count == 0 && level1Count == 0 && !advancing)
+        {
+            // Nothing is waiting on the old position, so jump ahead to now
+            currentTick = std::max(currentTick, nowTick());
+            expiryTick = std::max(expiryTick, currentTick + 1);
+        }
+        t.expiryTick = expiryTick;
+        place(t);
+        arm();
+    }
+
+    void unlink(Timer& t)
+    {
+        if (t.prev != nullptr)
+        {
+            t.prev->next = t.next;
+        }
+        else
+        {
+            *t.slot = t.next;
+        }
+        if (t.next != nullptr)
+        {
+            t.next->prev = t.prev;
+        }
+        if (t.slot >= level0.data() && t.slot < level0.data() + level0.size())
+        {
+            level0Count--;
+        }
+        else
+        {
+            level1Count--;
+        }
+        t.slot = nullptr;
+        t.prev = nullptr;
+        t.next = nullptr;
+    }
+
+    void remove(Timer& t)
+    {
+        unlink(t);
+        if (level0Count == 0 && level1Count == 0)
+        {
+            armedTick.reset();
+            timer.cancel();
+        }
+    }
+
+    void cascade()
+    {
+        Timer*& slot = level1[(currentTick / level0Slots) % level1Slots];
+        while (slot != nullptr)
+        {
+            Timer& t = *slot;
+            unlink(t);
+            place(t);
+        }
+    }
+
+    void expire()
+    {
+        Timer*& slot = level0[currentTick % level0Slots];
+        while (slot != nullptr)
+        {
+            Timer& t = *slot;
+            unlink(t);
+            // The handler may schedule this timer again
+            std::function<void()> handler = std::move(t.handler);
+            t.handler = nullptr;
+            handler();
+        }
+    }
+
+    void advance()
+    {
+        uint64_t targetTick = nowTick();
+        advancing = true;
+        while (currentTick < targetTick &&
+               (level0Count > 0 || level1Count > 0))
+        {
+            currentTick++;
+            if (currentTick % level0Slots == 0)
+            {
+                cascade();
+            }
+            expire();
+        }
+        advancing = false;
+        if (level0Count == 0 && level1Count == 0)
+        {
+            currentTick = std::max(currentTick, targetTick);
+        }
+    }
+
+    std::optional<uint64_t> nextTick() const
+    {
+        if (level0Count > 0)
+        {
+            for (uint64_t t = currentTick + 1; t < currentTick + level0Slots;
+                 t++)
+            {
+                if (level0[t % level0Slots] != nullptr)
+                {
+                    return t;
+                }
+            }
+        }
+        if (level1Count > 0)
+        {
+            // Wake up to cascade the next level 1 slot
+            return (currentTick / level0Slots + 1) * level0Slots;
+        }
+        return std::nullopt;
+    }
+
+    void arm()
+    {
+        std::optional<uint64_t> wakeTick = nextTick();
+        if (!wakeTick || wakeTick == armedTick)
+        {
+            return;
+        }
+
+        if constexpr (debug)
+        {
+            std::cerr << "Timer wheel armed for tick " << *wakeTick << "\n";
+        }
+
+        armedTick = wakeTick;
+        timer.expires_at(toTime(*wakeTick));
+        timer.async_wait([this](const boost::system::error_code ec) {
+            if (ec)
+            {
+                // operation_aborted is expected if the wheel is re-armed for
+                // an earlier tick
+                if (ec != boost::asio::error::operation_aborted)
+                {
+                    std::cerr << "Timer wheel async_wait failed: "
+                              << ec.message() << "\n";
+                }
+                return;
+            }
+            armedTick.reset();
+            advance();
+            arm();
+        });
+    }
+
+  public:
+    explicit TimerWheel(boost::asio::io_context& io) :
+        timer(io), origin(Clock::now())
+    {}
+};
+
+// A timer with the interface of TimerWheel::Timer that runs its handler at
+// its exact deadline on an asio timer of its own. For deadlines where a late
+// wakeup of up to a wheel tick matters more than sharing the wakeup.
+class ExactTimer
+{
+    boost::asio::steady_timer timer;
+    // Incremented on every schedule and cancel, so a wait that already
+    // completed before it was replaced does not run its handler
+    uint64_t generation = 0;
+    bool armed = false;
+
+  public:
+    explicit ExactTimer(boost::asio::io_context& io) : timer(io) {}
+    ExactTimer(const ExactTimer&) = delete;
+    ExactTimer& operator=(const ExactTimer&) = delete;
+
+    /** @brief Run a handler at a deadline
+     *  @param[in] deadline - Time to run the handler
+     *  @param[in] handler - Handler to run
+     */
+    void schedule(TimerWheel::Clock::time_point deadline,
+                  std::function<void()> handler)
+    {
+        uint64_t scheduled = ++generation;
+        armed = true;
+        // Any wait still pending is canceled by expires_at()
+        timer.expires_at(deadline);
+        timer.async_wait([this, scheduled, handler = std::move(handler)](
+                             const boost::system::error_code ec) {
+            if (ec)
+            {
+                // operation_aborted is expected if the timer is rescheduled,
+                // canceled or destroyed before it expires
+                if (ec != boost::asio::error::operation_aborted)
+                {
+                    std::cerr << "Exact timer async_wait failed: "
+                              << ec.message() << "\n";
+                }
+                return;
+            }
+            if (scheduled != generation)
+            {
+                return;
+            }
+            armed = false;
+            handler();
+        });
+    }
+
+    void cancel()
+    {
+        generation++;
+        armed = false;
+        timer.cancel();
+    }
+
+    bool pending() const
+    {
+        return armed;
+    }
+};
+
+inline TimerWheel& getTimerWheel(boost::asio::io_context& io)
+{
+    static TimerWheel wheel(io);
+    return wheel;
+}
+
+} // namespace host_error_monitor::timer_wheel
@@ -15,6 +15,7 @@
 */
 #include <boost/asio/io_context.hpp>
 #include <boost/container/flat_map.hpp>
+#include <dbus_objects.hpp>
 #include <error_monitors.hpp>
 #include <host_error_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
@@ -63,6 +64,10 @@ static void init()
                 return;
             }
             hostOff = *state == "xyz.openbmc_project.State.Host.HostState.Off";
+            if (!hostOff)
+            {
+                fillCPUIDCache(io);
+            }
 
             // Now we have the host state, we can init if needed
             init();
@@ -108,6 +113,13 @@ static void init()
 
             hostOff = *state == "xyz.openbmc_project.State.Host.HostState.Off";
 
+            // The CPUs may change across any host state transition
+            invalidateCPUIDCache();
+            if (!hostOff)
+            {
+                fillCPUIDCache(io);
+            }
+
             // Now we have the host state, we can init if needed
             init();
 
@@ -127,11 +139,10 @@ int main(int /*argc*/, char* /*argv*/[])
     host_error_monitor::conn =
         std::make_shared<sdbusplus::asio::connection>(host_error_monitor::io);
 
-    // Host Error Monitor Service
-    host_error_monitor::conn->request_name(
-        "xyz.openbmc_project.HostErrorMonitor");
-    sdbusplus::asio::object_server server =
-        sdbusplus::asio::object_server(host_error_monitor::conn);
+    // The monitors publish their objects through this one object server. It
+    // takes the service name once they have started.
+    host_error_monitor::dbus_objects::getObjectPublisher(
+        host_error_monitor::conn);
 
     // Start tracking host state
     std::shared_ptr<sdbusplus::bus::match_t> hostStateMonitor =
@@ -0,0 +1,227 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <cpu_registers.hpp>
+#include <peci_access.hpp>
+#include <peci_mock.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using host_error_monitor::cpu_registers::decodeErrPinSts;
+using host_error_monitor::cpu_registers::decodeIERR;
+using host_error_monitor::cpu_registers::Role;
+using host_error_monitor::peci_access::ccFatalMCADetected;
+using host_error_monitor::peci_access::minClientAddr;
+using host_error_monitor::peci_access::Model;
+using host_error_monitor::peci_access::Status;
+using host_error_monitor::peci_mock::MockPECIAccess;
+
+namespace
+{
+constexpr uint8_t cpuAddr = minClientAddr;
+// Sapphire Rapids, which the triage does not support
+constexpr Model sapphireRapids = static_cast<Model>(0x806F0);
+// MCA_ERR_SRC_LOG bit 27, IERR_INTERNAL
+constexpr uint64_t ierrInternal = 1 << 27;
+
+uint64_t mc4StatusWithMsec(uint8_t msec)
+{
+    return static_cast<uint64_t>(msec) << 24;
+}
+} // namespace
+
+class CPURegistersTest : public testing::TestWithParam<Model>
+{
+  protected:
+    MockPECIAccess* peci = nullptr;
+
+    void SetUp() override
+    {
+        std::unique_ptr<MockPECIAccess> access =
+            std::make_unique<MockPECIAccess>();
+        peci = access.get();
+        host_error_monitor::peci_access::setPECIAccess(std::move(access));
+        peci->addSocket(cpuAddr, GetParam());
+    }
+};
+
+TEST_P(CPURegistersTest, IERRFromAnotherCPU)
+{
+    EXPECT_EQ(decodeIERR(cpuAddr, GetParam()), std::nullopt);
+}
+
+TEST_P(CPURegistersTest, IERRWithoutSpecificCause)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "");
+}
+
+TEST_P(CPURegistersTest, IERRFromMSMIInternal)
+{
+    // MCA_ERR_SRC_LOG bit 20, MSMI_INTERNAL
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, 1 << 20);
+
+    EXPECT_TRUE(decodeIERR(cpuAddr, GetParam()));
+}
+
+TEST_P(CPURegistersTest, IERRFromVRMismatch)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(cpuAddr, Role::mc4Status, mc4StatusWithMsec(0x42));
+    // The MSEC cause is checked before the FIVR logs
+    peci->setRegister(cpuAddr, Role::coreFIVRErrLog, 1);
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "CPU/VR Mismatch");
+}
+
+TEST_P(CPURegistersTest, IERRStopsAtFirstCause)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(cpuAddr, Role::mc4Status, mc4StatusWithMsec(0x40));
+    // Reads of the FIVR logs would fail the triage
+    peci->setResponse(cpuAddr, Role::coreFIVRErrLog,
+                      {Status::timeout, 0, std::chrono::microseconds(0)});
+    peci->setResponse(cpuAddr, Role::uncoreFIVRErrLog,
+                      {Status::timeout, 0, std::chrono::microseconds(0)});
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "CPU/VR Mismatch");
+    // MCA_ERR_SRC_LOG and IA32_MC4_STATUS only
+    EXPECT_EQ(peci->commandCount(), 2);
+}
+
+TEST_P(CPURegistersTest, IERRFromCoreFIVR)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(cpuAddr, Role::coreFIVRErrLog, 0x10);
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "Core FIVR Fault");
+}
+
+TEST_P(CPURegistersTest, IERRFromUncoreFIVR)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(cpuAddr, Role::uncoreFIVRErrLog, 0x10);
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "Uncore FIVR Fault");
+}
+
+TEST_P(CPURegistersTest, IERRFromCoreFIVRWithoutUncoreRead)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(cpuAddr, Role::coreFIVRErrLog, 0x10);
+    peci->setResponse(cpuAddr, Role::uncoreFIVRErrLog,
+                      {Status::timeout, 0, std::chrono::microseconds(0)});
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "Core FIVR Fault");
+}
+
+TEST_P(CPURegistersTest, IERRFromFIVROvervoltage)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(cpuAddr, Role::mc4Status, mc4StatusWithMsec(0x51));
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, "Uncore FIVR Fault");
+}
+
+TEST_P(CPURegistersTest, IERRSourceUnreadable)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setResponse(cpuAddr, Role::mcaErrSrcLog,
+                      {Status::timeout, 0, std::chrono::microseconds(0)});
+
+    EXPECT_EQ(decodeIERR(cpuAddr, GetParam()), std::nullopt);
+}
+
+TEST_P(CPURegistersTest, IERRCauseUnreadable)
+{
+    peci->setRegister(cpuAddr, Role::mcaErrSrcLog, ierrInternal);
+    peci->setResponse(cpuAddr, Role::mc4Status,
+                      {Status::driverErr, 0, std::chrono::microseconds(0)});
+
+    std::optional<std::optional<std::string>> type =
+        decodeIERR(cpuAddr, GetParam());
+    ASSERT_TRUE(type);
+    EXPECT_EQ(*type, std::nullopt);
+}
+
+TEST_P(CPURegistersTest, ErrPinAsserted)
+{
+    peci->setRegister(cpuAddr, Role::errPinSts, 1 << 2);
+
+    EXPECT_TRUE(decodeErrPinSts(cpuAddr, GetParam(), 2));
+    EXPECT_FALSE(decodeErrPinSts(cpuAddr, GetParam(), 1));
+}
+
+TEST_P(CPURegistersTest, ErrPinReadAfterFatalMCA)
+{
+    // A CPU that hit a fatal MCA still answers with valid data
+    peci->setRegister(cpuAddr, Role::errPinSts, 1 << 2);
+    peci->setResponse(cpuAddr, Role::errPinSts,
+                      {Status::success, ccFatalMCADetected,
+                       std::chrono::microseconds(0)});
+
+    EXPECT_TRUE(decodeErrPinSts(cpuAddr, GetParam(), 2));
+}
+
+TEST_P(CPURegistersTest, ErrPinUnreadable)
+{
+    peci->setRegister(cpuAddr, Role::errPinSts, 1 << 2);
+    peci->setResponse(cpuAddr, Role::errPinSts,
+                      {Status::timeout, 0, std::chrono::microseconds(0)});
+
+    EXPECT_FALSE(decodeErrPinSts(cpuAddr, GetParam(), 2));
+}
+
+INSTANTIATE_TEST_SUITE_P(SupportedModels, CPURegistersTest,
+                         testing::Values(Model::skylake, Model::iceLake));
+
+TEST(CPURegisters, UnsupportedModel)
+{
+    std::unique_ptr<MockPECIAccess> access =
+        std::make_unique<MockPECIAccess>();
+    MockPECIAccess& peci = *access;
+    host_error_monitor::peci_access::setPECIAccess(std::move(access));
+    peci.addSocket(cpuAddr, sapphireRapids);
+
+    EXPECT_EQ(decodeIERR(cpuAddr, sapphireRapids), std::nullopt);
+    EXPECT_FALSE(decodeErrPinSts(cpuAddr, sapphireRapids, 0));
+    EXPECT_EQ(peci.commandCount(), 0);
+}
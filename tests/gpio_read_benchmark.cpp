@@ -0,0 +1,94 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <fcntl.h>
+#include <gpiod.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <system_error>
+
+#include <benchmark/benchmark.h>
+
+// Flushing an empty event queue, as a poll monitor does on every tick. An
+// empty non-blocking pipe stands in for the line's event fd, so every read
+// fails with EAGAIN.
+class EmptyEventQueue : public benchmark::Fixture
+{
+  protected:
+    std::array<int, 2> fds{-1, -1};
+
+  public:
+    void SetUp(const benchmark::State&) override
+    {
+        if (pipe2(fds.data(), O_NONBLOCK) < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "pipe2");
+        }
+    }
+
+    void TearDown(const benchmark::State&) override
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+};
+
+// The read path GPIOLine::readEvents() takes: one read of up to a buffer of
+// events, with EAGAIN reported as an empty result
+BENCHMARK_F(EmptyEventQueue, errorCodeFlush)(benchmark::State& state)
+{
+    std::array<gpiod_line_event, 16> events;
+    for (auto _ : state)
+    {
+        std::error_code ec;
+        int read = gpiod_line_event_read_fd_multiple(fds[0], events.data(),
+                                                     events.size());
+        if (read < 0 && errno != EAGAIN)
+        {
+            ec = std::error_code(errno, std::generic_category());
+        }
+        benchmark::DoNotOptimize(read);
+        benchmark::DoNotOptimize(ec);
+    }
+}
+
+// The read path replaced by GPIOLine: one event per read, with the empty
+// queue found by catching the exception gpiod::line::event_read() throws
+BENCHMARK_F(EmptyEventQueue, exceptionFlush)(benchmark::State& state)
+{
+    gpiod_line_event event;
+    for (auto _ : state)
+    {
+        try
+        {
+            while (true)
+            {
+                if (gpiod_line_event_read_fd(fds[0], &event) < 0)
+                {
+                    throw std::system_error(errno, std::system_category(),
+                                            "error reading line event");
+                }
+            }
+        }
+        catch (std::system_error&)
+        {
+            benchmark::DoNotOptimize(event);
+        }
+    }
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,146 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <error_monitors/ierr_monitor.hpp>
+#include <host_error_monitor.hpp>
+#include <peci_access.hpp>
+#include <peci_mock.hpp>
+
+#include <bitset>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using host_error_monitor::CPUInfo;
+using host_error_monitor::getCPUIDCache;
+using host_error_monitor::cpu_registers::Role;
+using host_error_monitor::ierr_monitor::checkIERRCPUs;
+using host_error_monitor::ierr_monitor::CPUIERR;
+using host_error_monitor::peci_access::minClientAddr;
+using host_error_monitor::peci_access::Model;
+using host_error_monitor::peci_access::Status;
+using host_error_monitor::peci_mock::MockPECIAccess;
+
+namespace
+{
+// MCA_ERR_SRC_LOG bit 27, IERR_INTERNAL
+constexpr uint64_t ierrInternal = 1 << 27;
+// Sapphire Rapids, which the triage does not support
+constexpr Model sapphireRapids = static_cast<Model>(0x806F0);
+} // namespace
+
+class IERRTriageTest : public testing::Test
+{
+  protected:
+    MockPECIAccess* peci = nullptr;
+
+    void SetUp() override
+    {
+        std::unique_ptr<MockPECIAccess> access =
+            std::make_unique<MockPECIAccess>();
+        peci = access.get();
+        host_error_monitor::peci_access::setPECIAccess(std::move(access));
+        getCPUIDCache().invalidate();
+    }
+};
+
+TEST_F(IERRTriageTest, CPUsProbedOnce)
+{
+    peci->addSocket(minClientAddr, Model::skylake);
+    peci->addSocket(minClientAddr + 2, Model::skylake, 4);
+
+    std::vector<CPUInfo> cpus = getCPUIDCache().getCPUs();
+    ASSERT_EQ(cpus.size(), 2);
+    EXPECT_EQ(cpus[0].cpu, 0);
+    EXPECT_EQ(cpus[0].addr, minClientAddr);
+    EXPECT_EQ(cpus[1].cpu, 2);
+    EXPECT_EQ(cpus[1].addr, minClientAddr + 2);
+    EXPECT_EQ(cpus[1].stepping, 4);
+
+    size_t commands = peci->commandCount();
+    EXPECT_EQ(getCPUIDCache().getCPUs().size(), 2);
+    EXPECT_EQ(peci->commandCount(), commands);
+}
+
+TEST_F(IERRTriageTest, CPUsProbedAgainAfterInvalidate)
+{
+    peci->addSocket(minClientAddr, Model::iceLake);
+    EXPECT_EQ(getCPUIDCache().getCPUs().size(), 1);
+
+    peci->addSocket(minClientAddr + 1, Model::iceLake);
+    EXPECT_EQ(getCPUIDCache().getCPUs().size(), 1);
+
+    getCPUIDCache().invalidate();
+    EXPECT_EQ(getCPUIDCache().getCPUs().size(), 2);
+}
+
+TEST_F(IERRTriageTest, UnsupportedCPUSkipped)
+{
+    peci->addSocket(minClientAddr, sapphireRapids);
+    peci->addSocket(minClientAddr + 1, Model::skylake);
+
+    std::vector<CPUInfo> cpus = getCPUIDCache().getCPUs();
+    ASSERT_EQ(cpus.size(), 1);
+    EXPECT_EQ(cpus[0].cpu, 1);
+}
+
+TEST_F(IERRTriageTest, FailedProbeNotCached)
+{
+    peci->addSocket(minClientAddr, Model::skylake);
+    peci->addSocket(minClientAddr + 1, Model::skylake);
+    peci->setCPUIDResponse(minClientAddr + 1,
+                           {Status::timeout, 0, std::chrono::microseconds(0)});
+    EXPECT_EQ(getCPUIDCache().getCPUs().size(), 1);
+
+    peci->setCPUIDResponse(minClientAddr + 1, {});
+    EXPECT_EQ(getCPUIDCache().getCPUs().size(), 2);
+}
+
+TEST_F(IERRTriageTest, SerialAndParallelTriageMatch)
+{
+    for (uint8_t addr = minClientAddr; addr < minClientAddr + 4; addr++)
+    {
+        peci->addSocket(addr, Model::iceLake);
+    }
+    peci->setRegister(minClientAddr + 1, Role::mcaErrSrcLog, ierrInternal);
+    peci->setRegister(minClientAddr + 1, Role::coreFIVRErrLog, 0x10);
+    peci->setRegister(minClientAddr + 3, Role::mcaErrSrcLog, ierrInternal);
+
+    for (bool parallel : {false, true})
+    {
+        std::vector<CPUIERR> ierrCPUs = checkIERRCPUs(parallel);
+        ASSERT_EQ(ierrCPUs.size(), 2);
+        EXPECT_EQ(ierrCPUs[0].cpu, 1);
+        EXPECT_EQ(ierrCPUs[0].type, "Core FIVR Fault");
+        EXPECT_EQ(ierrCPUs[1].cpu, 3);
+        EXPECT_EQ(ierrCPUs[1].type, "");
+    }
+}
+
+TEST_F(IERRTriageTest, ErrPinCPUs)
+{
+    peci->addSocket(minClientAddr, Model::skylake);
+    peci->addSocket(minClientAddr + 1, Model::skylake);
+    peci->addSocket(minClientAddr + 2, Model::skylake);
+    peci->setRegister(minClientAddr, Role::errPinSts, 1 << 1);
+    peci->setRegister(minClientAddr + 2, Role::errPinSts, 1 << 1);
+    peci->setRegister(minClientAddr + 1, Role::errPinSts, 1 << 2);
+
+    std::bitset<MAX_CPUS> errPinCPUs = host_error_monitor::checkErrPinCPUs(1);
+    EXPECT_EQ(errPinCPUs, std::bitset<MAX_CPUS>("101"));
+}
@@ -0,0 +1,124 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <timer_wheel.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using host_error_monitor::timer_wheel::TimerWheel;
+
+namespace
+{
+// Asserted poll monitors, each polling at the IERR monitor's interval, with
+// their deadlines spread evenly across it
+constexpr size_t monitors = 64;
+constexpr std::chrono::milliseconds pollInterval(100);
+constexpr std::chrono::seconds window(1);
+
+std::chrono::steady_clock::duration offset(size_t monitor)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+               pollInterval) *
+           monitor / monitors;
+}
+
+void reportWakeups(benchmark::State& state, size_t wakeups, size_t polls)
+{
+    state.counters["wakeups/s"] =
+        benchmark::Counter(wakeups, benchmark::Counter::kIsRate);
+    state.counters["polls/s"] =
+        benchmark::Counter(polls, benchmark::Counter::kIsRate);
+}
+} // namespace
+
+// Every poll timer on the one shared wheel
+static void timerWheelPolls(benchmark::State& state)
+{
+    boost::asio::io_context io;
+    TimerWheel wheel(io);
+    std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+    size_t polls = 0;
+    std::function<void(TimerWheel::Timer&)> poll =
+        [&polls, &poll](TimerWheel::Timer& timer) {
+            polls++;
+            timer.schedule(TimerWheel::Clock::now() + pollInterval,
+                           [&timer, &poll]() { poll(timer); });
+        };
+    for (size_t monitor = 0; monitor < monitors; monitor++)
+    {
+        TimerWheel::Timer& timer =
+            *timers.emplace_back(std::make_unique<TimerWheel::Timer>(wheel));
+        timer.schedule(TimerWheel::Clock::now() + offset(monitor),
+                       [&timer, &poll]() { poll(timer); });
+    }
+
+    size_t wakeups = 0;
+    for (auto _ : state)
+    {
+        wakeups += io.run_for(window);
+    }
+    reportWakeups(state, wakeups, polls);
+}
+
+// Every poll timer on its own steady_timer, as the poll monitors were
+// before the wheel
+static void steadyTimerPolls(benchmark::State& state)
+{
+    boost::asio::io_context io;
+    std::vector<std::unique_ptr<boost::asio::steady_timer>> timers;
+    size_t polls = 0;
+    std::function<void(boost::asio::steady_timer&)> poll =
+        [&polls, &poll](boost::asio::steady_timer& timer) {
+            polls++;
+            timer.expires_after(pollInterval);
+            timer.async_wait([&timer, &poll](boost::system::error_code ec) {
+                if (!ec)
+                {
+                    poll(timer);
+                }
+            });
+        };
+    for (size_t monitor = 0; monitor < monitors; monitor++)
+    {
+        boost::asio::steady_timer& timer = *timers.emplace_back(
+            std::make_unique<boost::asio::steady_timer>(io));
+        timer.expires_after(offset(monitor));
+        timer.async_wait([&timer, &poll](boost::system::error_code ec) {
+            if (!ec)
+            {
+                poll(timer);
+            }
+        });
+    }
+
+    size_t wakeups = 0;
+    for (auto _ : state)
+    {
+        wakeups += io.run_for(window);
+    }
+    reportWakeups(state, wakeups, polls);
+}
+
+BENCHMARK(timerWheelPolls)->Iterations(3)->UseRealTime();
+BENCHMARK(steadyTimerPolls)->Iterations(3)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <error_monitors/ierr_monitor.hpp>
+#include <host_error_monitor.hpp>
+#include <peci_access.hpp>
+#include <peci_mock.hpp>
+
+#include <chrono>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+using host_error_monitor::cpu_registers::Role;
+using host_error_monitor::peci_access::minClientAddr;
+using host_error_monitor::peci_access::Model;
+using host_error_monitor::peci_mock::MockPECIAccess;
+
+// IERR triage of every socket with each PECI command taking a fixed time.
+// Arguments are the socket count and the command latency in microseconds.
+static void triage(benchmark::State& state, bool parallel)
+{
+    std::unique_ptr<MockPECIAccess> access =
+        std::make_unique<MockPECIAccess>();
+    MockPECIAccess& peci = *access;
+    host_error_monitor::peci_access::setPECIAccess(std::move(access));
+    const int64_t sockets = state.range(0);
+    for (uint8_t addr = minClientAddr; addr < minClientAddr + sockets;
+         addr++)
+    {
+        peci.addSocket(addr, Model::iceLake);
+        // MCA_ERR_SRC_LOG bit 27, IERR_INTERNAL, so every cause is read
+        peci.setRegister(addr, Role::mcaErrSrcLog, 1 << 27);
+    }
+    // Probe the CPUs before the latency applies, as the cache is warm by the
+    // time an IERR is triaged
+    host_error_monitor::getCPUIDCache().invalidate();
+    host_error_monitor::getCPUIDCache().getCPUs();
+    peci.setLatency(std::chrono::microseconds(state.range(1)));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            host_error_monitor::ierr_monitor::checkIERRCPUs(parallel));
+    }
+}
+
+static void serialTriage(benchmark::State& state)
+{
+    triage(state, false);
+}
+
+static void parallelTriage(benchmark::State& state)
+{
+    triage(state, true);
+}
+
+BENCHMARK(serialTriage)
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 100}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(parallelTriage)
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 100}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,157 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#include <error_monitors/ierr_monitor.hpp>
+#include <host_error_monitor.hpp>
+#include <peci_access.hpp>
+#include <peci_mock.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using host_error_monitor::cpu_registers::Role;
+using host_error_monitor::peci_access::minClientAddr;
+using host_error_monitor::peci_access::Model;
+using host_error_monitor::peci_access::Status;
+using host_error_monitor::peci_mock::MockPECIAccess;
+
+namespace
+{
+// Time of a PECI command that completes, and of one that times out
+constexpr std::chrono::microseconds commandLatency(100);
+constexpr std::chrono::microseconds peciTimeout(5000);
+// Completion code of a CPU asking for the command to be retried
+constexpr uint8_t ccNeedRetry = 0x80;
+// Each repetition is one triage, so the percentiles are of single triages
+constexpr int repetitions = 100;
+
+// How the triage's first register read completes on the sockets
+enum class Failures
+{
+    // Every read completes
+    none,
+    // The read of the last socket times out
+    timeout,
+    // Every socket answers the read with an error completion code
+    errorCC,
+};
+
+// Nearest rank percentile of the repetition times
+template <int percent>
+double percentile(const std::vector<double>& times)
+{
+    if (times.empty())
+    {
+        return 0;
+    }
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = static_cast<size_t>(
+        std::ceil(percent / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+/** @brief Install a mock with the sockets and failures of the arguments
+ *  @param[in] state - Benchmark state with the socket count and Failures
+ *  @param[in] role - Register role the triage reads first
+ *  @param[in] value - Value of that register on every socket
+ */
+void setUpSockets(const benchmark::State& state, Role role, uint64_t value)
+{
+    std::unique_ptr<MockPECIAccess> access =
+        std::make_unique<MockPECIAccess>();
+    MockPECIAccess& peci = *access;
+    host_error_monitor::peci_access::setPECIAccess(std::move(access));
+    const uint8_t lastAddr = minClientAddr + state.range(0) - 1;
+    const Failures failures = static_cast<Failures>(state.range(1));
+    for (uint8_t addr = minClientAddr; addr <= lastAddr; addr++)
+    {
+        peci.addSocket(addr, Model::iceLake);
+        peci.setRegister(addr, role, value);
+        if (failures == Failures::errorCC)
+        {
+            peci.setResponse(addr, role,
+                             {Status::success, ccNeedRetry, commandLatency});
+        }
+    }
+    if (failures == Failures::timeout)
+    {
+        peci.setResponse(lastAddr, role, {Status::timeout, 0, peciTimeout});
+    }
+    // Probe the CPUs before the latency applies, as the cache is warm by the
+    // time an error is triaged
+    host_error_monitor::getCPUIDCache().invalidate();
+    host_error_monitor::getCPUIDCache().getCPUs();
+    peci.setLatency(commandLatency);
+}
+
+void ierrTriage(benchmark::State& state, bool parallel)
+{
+    // MCA_ERR_SRC_LOG bit 27, IERR_INTERNAL, so every cause is read
+    setUpSockets(state, Role::mcaErrSrcLog, 1 << 27);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(
+            host_error_monitor::ierr_monitor::checkIERRCPUs(parallel));
+    }
+}
+} // namespace
+
+// ERR2 triage, which reads ERRPINSTS on every socket
+static void errPinTriage(benchmark::State& state)
+{
+    setUpSockets(state, Role::errPinSts, 1 << 2);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(host_error_monitor::checkErrPinCPUs(2));
+    }
+}
+
+static void serialIERRTriage(benchmark::State& state)
+{
+    ierrTriage(state, false);
+}
+
+static void parallelIERRTriage(benchmark::State& state)
+{
+    ierrTriage(state, true);
+}
+
+// Arguments are the socket count and the Failures
+static void triageArgs(benchmark::internal::Benchmark* b)
+{
+    b->ArgsProduct({{1, 2, 4, 8},
+                    {static_cast<int64_t>(Failures::none),
+                     static_cast<int64_t>(Failures::timeout),
+                     static_cast<int64_t>(Failures::errorCC)}})
+        ->Unit(benchmark::kMicrosecond)
+        ->UseRealTime()
+        ->Iterations(1)
+        ->Repetitions(repetitions)
+        ->ComputeStatistics("p50", percentile<50>)
+        ->ComputeStatistics("p99", percentile<99>)
+        ->ReportAggregatesOnly(true);
+}
+
+BENCHMARK(errPinTriage)->Apply(triageArgs);
+BENCHMARK(serialIERRTriage)->Apply(triageArgs);
+BENCHMARK(parallelIERRTriage)->Apply(triageArgs);
+
+BENCHMARK_MAIN();